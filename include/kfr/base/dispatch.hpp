@@ -69,6 +69,24 @@ namespace internal
 template <cpu_t a>
 struct cpu_caller;
 
+template <>
+struct cpu_caller<cpu_t::avx512>
+{
+    constexpr static cpu_t a = cpu_t::avx512;
+
+    template <typename Fn, typename... Args>
+    KFR_NOINLINE static KFR_USE_CPU(avx512) result_of<Fn(Args...)> call(Fn&& fn, Args&&... args)
+    {
+        return fn(std::forward<Args>(args)...);
+    }
+
+    template <typename Fn, typename... Args>
+    KFR_NOINLINE static KFR_USE_CPU(avx512) result_of<Fn(Args...)> retarget_call(Fn&& fn, Args&&... args)
+    {
+        return (retarget_func<a>(std::forward<Fn>(fn)))(std::forward<Args>(args)...);
+    }
+};
+
 template <>
 struct cpu_caller<cpu_t::avx2>
 {
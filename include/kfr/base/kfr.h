@@ -93,6 +93,7 @@ constexpr int version                 = KFR_VERSION;
 
 #endif
 
+#define KFR_AVAIL_AVX512 1
 #define KFR_AVAIL_AVX2 1
 #define KFR_AVAIL_AVX 1
 #define KFR_AVAIL_SSE42 1
@@ -104,6 +105,7 @@ constexpr int version                 = KFR_VERSION;
 
 #if defined(KFR_GNU_ATTRIBUTES)
 
+#define KFR_CPU_NAME_avx512 "avx512f,avx512cd,avx512bw,avx512dq,avx512vl"
 #define KFR_CPU_NAME_avx2 "avx2"
 #define KFR_CPU_NAME_avx "avx"
 #define KFR_CPU_NAME_sse42 "sse4.2"
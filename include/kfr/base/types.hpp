@@ -321,10 +321,11 @@ enum class cpu_t : int
     sse42   = 4,
     avx1    = 5,
     avx2    = 6,
+    avx512  = 7,
     avx     = static_cast<int>(avx1),
     native  = static_cast<int>(KFR_ARCH_NAME),
     lowest  = static_cast<int>(sse2),
-    highest = static_cast<int>(avx2),
+    highest = static_cast<int>(avx512),
     runtime = -1,
 };
 
@@ -339,8 +340,8 @@ namespace internal
 constexpr cpu_t older(cpu_t x) { return static_cast<cpu_t>(static_cast<int>(x) - 1); }
 constexpr cpu_t newer(cpu_t x) { return static_cast<cpu_t>(static_cast<int>(x) + 1); }
 
-constexpr auto cpu_list =
-    cvals<cpu_t, cpu_t::avx2, cpu_t::avx1, cpu_t::sse41, cpu_t::ssse3, cpu_t::sse3, cpu_t::sse2>;
+constexpr auto cpu_list = cvals<cpu_t, cpu_t::avx512, cpu_t::avx2, cpu_t::avx1, cpu_t::sse41, cpu_t::ssse3,
+                                cpu_t::sse3, cpu_t::sse2>;
 }
 
 template <cpu_t cpu>
@@ -558,7 +559,7 @@ constexpr inline static const T* derived_cast(const U* ptr)
 
 __attribute__((unused)) static const char* cpu_name(cpu_t set)
 {
-    static const char* names[] = { "sse2", "sse3", "ssse3", "sse41", "sse42", "avx1", "avx2" };
+    static const char* names[] = { "sse2", "sse3", "ssse3", "sse41", "sse42", "avx1", "avx2", "avx512" };
     if (set >= cpu_t::lowest && set <= cpu_t::highest)
         return names[static_cast<size_t>(set)];
     return "-";
@@ -636,13 +637,20 @@ constexpr inline T bitness_const(T x32, T x64)
 
 constexpr size_t native_cache_alignment        = 64;
 constexpr size_t native_cache_alignment_mask   = native_cache_alignment - 1;
-constexpr size_t maximum_vector_alignment      = 32;
+#ifdef KFR_AVAIL_AVX512
+// avx512 kernels are built into every binary and selected at runtime, so align for 64-byte vectors
+constexpr size_t maximum_vector_alignment = 64;
+#else
+constexpr size_t maximum_vector_alignment = 32;
+#endif
 constexpr size_t maximum_vector_alignment_mask = maximum_vector_alignment - 1;
 constexpr size_t native_register_count         = bitness_const(8, 16);
 template <cpu_t c>
-constexpr size_t native_float_vector_size = c >= cpu_t::avx1 ? 32 : c >= cpu_t::sse2 ? 16 : 0;
+constexpr size_t native_float_vector_size =
+    c >= cpu_t::avx512 ? 64 : c >= cpu_t::avx1 ? 32 : c >= cpu_t::sse2 ? 16 : 0;
 template <cpu_t c>
-constexpr size_t native_int_vector_size = c >= cpu_t::avx2 ? 32 : c >= cpu_t::sse2 ? 16 : 0;
+constexpr size_t native_int_vector_size =
+    c >= cpu_t::avx512 ? 64 : c >= cpu_t::avx2 ? 32 : c >= cpu_t::sse2 ? 16 : 0;
 
 struct input_expression
 {
@@ -1085,6 +1085,17 @@ using mu16avx = mask<u16, vector_width<u16, cpu_t::avx2>>;
 using mu32avx = mask<u32, vector_width<u32, cpu_t::avx2>>;
 using mu64avx = mask<u64, vector_width<u64, cpu_t::avx2>>;
 
+using f32avx512 = vec<f32, vector_width<f32, cpu_t::avx512>>;
+using f64avx512 = vec<f64, vector_width<f64, cpu_t::avx512>>;
+using i8avx512  = vec<i8, vector_width<i8, cpu_t::avx512>>;
+using i16avx512 = vec<i16, vector_width<i16, cpu_t::avx512>>;
+using i32avx512 = vec<i32, vector_width<i32, cpu_t::avx512>>;
+using i64avx512 = vec<i64, vector_width<i64, cpu_t::avx512>>;
+using u8avx512  = vec<u8, vector_width<u8, cpu_t::avx512>>;
+using u16avx512 = vec<u16, vector_width<u16, cpu_t::avx512>>;
+using u32avx512 = vec<u32, vector_width<u32, cpu_t::avx512>>;
+using u64avx512 = vec<u64, vector_width<u64, cpu_t::avx512>>;
+
 template <typename T, size_t N>
 struct vec_type
 {
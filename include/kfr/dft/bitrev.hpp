@@ -267,7 +267,7 @@ KFR_INTRIN void fft_reorder_swap_n4(T* inout, size_t i, size_t j, size_t N4, cbo
 }
 
 template <typename T>
-KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, ctrue_t use_br2)
+KFR_INTRIN void fft_reorder_swaps(complex<T>* inout, size_t log2n, ctrue_t use_br2)
 {
     const size_t N         = 1 << log2n;
     const size_t N4        = N / 4;
@@ -302,7 +302,7 @@ KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, ctrue_t use_br2)
 }
 
 template <typename T>
-KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cfalse_t use_br2)
+KFR_INTRIN void fft_reorder_swaps(complex<T>* inout, size_t log2n, cfalse_t use_br2)
 {
     const size_t N         = size_t(1) << log2n;
     const size_t N4        = N / 4;
@@ -383,5 +383,121 @@ KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cfalse_t use_br2)
         i += istep;
     }
 }
+
+// Bit reversal (use_br2) or base-4 digit reversal of the lower bits of x
+template <bool use_br2>
+KFR_INTRIN size_t fft_reverse_index(size_t x, size_t bits, cbool_t<use_br2>)
+{
+    return use_br2 ? bitrev_using_table(static_cast<u32>(x), bits)
+                   : dig4rev_using_table(static_cast<u32>(x), bits);
+}
+
+// Reorders that don't fit in this many bytes use fft_reorder_blocked
+constexpr size_t fft_reorder_blocked_bytes = 512 * 1024;
+
+// Tile side for fft_reorder_blocked, in bits. Even so that tiles split the index on base-4 digits
+constexpr size_t fft_reorder_tile_bits = 4;
+
+// Cache-blocked reorder (COBRA). The index is split into [a | b | c] where a and c have tile_bits
+// bits, so that reverse(a b c) = reverse(c) reverse(b) reverse(a). For every pair b, reverse(b)
+// both tiles of 2^tile_bits rows are copied to a small buffer and written back transposed, so that
+// every row is read and written as a contiguous run instead of one element per cache line
+template <typename T, bool use_br2>
+KFR_NOINLINE void fft_reorder_blocked(complex<T>* inout, size_t log2n, cbool_t<use_br2>)
+{
+    constexpr size_t tile_bits = fft_reorder_tile_bits;
+    constexpr size_t tile      = size_t(1) << tile_bits;
+    const size_t mid_bits      = log2n - 2 * tile_bits;
+    const size_t row_stride    = size_t(1) << (log2n - tile_bits);
+
+    size_t rev[tile];
+    for (size_t i = 0; i < tile; i++)
+        rev[i] = fft_reverse_index(i, tile_bits, cbool<use_br2>);
+
+    complex<T> tile_b[tile * tile];
+    complex<T> tile_rb[tile * tile];
+    for (size_t b = 0; b < (size_t(1) << mid_bits); b++)
+    {
+        const size_t rb = fft_reverse_index(b, mid_bits, cbool<use_br2>);
+        if (rb < b)
+            continue;
+        complex<T>* src_b  = inout + (b << tile_bits);
+        complex<T>* src_rb = inout + (rb << tile_bits);
+        for (size_t a = 0; a < tile; a++)
+            for (size_t c = 0; c < tile; c++)
+                tile_b[a * tile + c] = src_b[a * row_stride + c];
+        if (rb != b)
+        {
+            for (size_t a = 0; a < tile; a++)
+                for (size_t c = 0; c < tile; c++)
+                    tile_rb[a * tile + c] = src_rb[a * row_stride + c];
+        }
+        // Element (a, b, c) moves to (reverse(c), reverse(b), reverse(a))
+        for (size_t c = 0; c < tile; c++)
+        {
+            complex<T>* dst_rb = src_rb + rev[c] * row_stride;
+            for (size_t a = 0; a < tile; a++)
+                dst_rb[rev[a]] = tile_b[a * tile + c];
+        }
+        if (rb != b)
+        {
+            for (size_t c = 0; c < tile; c++)
+            {
+                complex<T>* dst_b = src_b + rev[c] * row_stride;
+                for (size_t a = 0; a < tile; a++)
+                    dst_b[rev[a]] = tile_rb[a * tile + c];
+            }
+        }
+    }
+}
+
+// Out of place reorder that also converts every element: out[reverse(i)] = convert(in[i]).
+// convert maps vec<T, 2 * N> (N interleaved complex values) to vec<T, N>. Rows of a tile are read and
+// converted as vectors, then the converted tile is transposed through a small buffer as in
+// fft_reorder_blocked, so both in and out are accessed in contiguous runs
+template <typename T, bool use_br2, typename Fn>
+KFR_INTRIN void fft_reorder_convert(T* out, const complex<T>* in, size_t log2n, cbool_t<use_br2>,
+                                    Fn&& convert)
+{
+    constexpr size_t tile_bits = fft_reorder_tile_bits;
+    constexpr size_t tile      = size_t(1) << tile_bits;
+    if (log2n < 2 * tile_bits)
+    {
+        for (size_t i = 0; i < (size_t(1) << log2n); i++)
+            out[fft_reverse_index(i, log2n, cbool<use_br2>)] = convert(cread<1>(in + i))[0];
+        return;
+    }
+    const size_t mid_bits   = log2n - 2 * tile_bits;
+    const size_t row_stride = size_t(1) << (log2n - tile_bits);
+
+    size_t rev[tile];
+    for (size_t i = 0; i < tile; i++)
+        rev[i] = fft_reverse_index(i, tile_bits, cbool<use_br2>);
+
+    T transposed[tile * tile];
+    for (size_t b = 0; b < (size_t(1) << mid_bits); b++)
+    {
+        const complex<T>* src = in + (b << tile_bits);
+        // Element (a, b, c) moves to (reverse(c), reverse(b), reverse(a))
+        for (size_t a = 0; a < tile; a++)
+        {
+            const vec<T, tile> row = convert(cread<tile>(src + a * row_stride));
+            for (size_t c = 0; c < tile; c++)
+                transposed[rev[c] * tile + rev[a]] = row[c];
+        }
+        T* dst = out + (fft_reverse_index(b, mid_bits, cbool<use_br2>) << tile_bits);
+        for (size_t c = 0; c < tile; c++)
+            write(dst + c * row_stride, read<tile>(transposed + c * tile));
+    }
+}
+
+template <typename T, bool use_br2>
+KFR_INTRIN void fft_reorder(complex<T>* inout, size_t log2n, cbool_t<use_br2>)
+{
+    if ((sizeof(complex<T>) << log2n) > fft_reorder_blocked_bytes)
+        fft_reorder_blocked(inout, log2n, cbool<use_br2>);
+    else
+        fft_reorder_swaps(inout, log2n, cbool<use_br2>);
+}
 }
 }
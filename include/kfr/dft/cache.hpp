@@ -0,0 +1,234 @@
+/**
+ * Copyright (C) 2016 D Levin (http://www.kfrlib.com)
+ * This file is part of KFR
+ *
+ * KFR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KFR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KFR.
+ *
+ * If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+ * Buying a commercial license is mandatory as soon as you develop commercial activities without
+ * disclosing the source code of your own applications.
+ * See http://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "fft.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace kfr
+{
+
+/// Process-wide cache of shared immutable dft_plan<T> objects keyed by size and direction.
+/// Lookups read an atomically published immutable table without taking the cache mutex or any other lock,
+/// misses build the plan outside the mutex. When the memory held only by the cache exceeds the memory
+/// limit, the least recently used plans that no caller holds are dropped.
+template <typename T>
+class dft_plan_cache
+{
+public:
+    using plan_ptr = std::shared_ptr<const dft_plan<T>>;
+
+    constexpr static size_t default_memory_limit = 256 * 1048576;
+
+    static dft_plan_cache& instance()
+    {
+        static dft_plan_cache cache;
+        return cache;
+    }
+
+    template <bool direct = true, bool inverse = true>
+    plan_ptr get(size_t size, cbools_t<direct, inverse> type = dft_type::both)
+    {
+        const int dir = int(direct) | int(inverse) << 1;
+        {
+            const read_guard guard(*this);
+            const table& snapshot = guard.get();
+            const auto it         = lookup(snapshot, size, dir);
+            if (it != snapshot.end() && matches(**it, size, dir))
+            {
+                touch(**it);
+                return (*it)->plan;
+            }
+        }
+        return insert(size, dir, std::make_shared<dft_plan<T>>(size, type));
+    }
+
+    void set_memory_limit(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        memory_limit = bytes;
+        std::unique_ptr<table> updated(new table(*current.load()));
+        evict(*updated, nullptr);
+        publish(std::move(updated));
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        publish(std::unique_ptr<table>(new table()));
+    }
+
+    size_t size() const
+    {
+        const read_guard guard(*this);
+        return guard.get().size();
+    }
+
+    // Bytes that dropping every plan would free, see exclusive_memory
+    size_t memory_usage() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return exclusive_memory(*current.load());
+    }
+
+    ~dft_plan_cache() { delete current.load(); }
+
+private:
+    struct entry
+    {
+        size_t size;
+        int dir;
+        plan_ptr plan;
+        std::atomic<u64> last_used;
+    };
+    using entry_ptr = std::shared_ptr<entry>;
+    using table     = std::vector<entry_ptr>;
+
+    // Tables are immutable once published. A replaced table is retired and freed by a later publish
+    // that finds no reader inside a read_guard. A reader that loads the table after the replacement
+    // sees the new one, so the check can't miss a reader of a retired table. Under a continuous stream
+    // of lookups retired tables wait for the next quiet publish or the destruction of the cache
+    class read_guard
+    {
+    public:
+        explicit read_guard(const dft_plan_cache& cache) : cache(cache) { cache.readers.fetch_add(1); }
+        ~read_guard() { cache.readers.fetch_sub(1); }
+        const table& get() const { return *cache.current.load(); }
+
+    private:
+        const dft_plan_cache& cache;
+    };
+
+    dft_plan_cache() : current(new table()), readers(0), clock(0), memory_limit(default_memory_limit) {}
+
+    static typename table::const_iterator lookup(const table& t, size_t size, int dir)
+    {
+        return std::lower_bound(t.begin(), t.end(), std::make_pair(size, dir),
+                                [](const entry_ptr& e, const std::pair<size_t, int>& key) {
+                                    return std::make_pair(e->size, e->dir) < key;
+                                });
+    }
+    static bool matches(const entry& e, size_t size, int dir) { return e.size == size && e.dir == dir; }
+
+    // True if only the cache holds the plan, so dropping it frees its memory
+    static bool exclusive(const entry& e) { return e.plan.use_count() == 1; }
+
+    // Bytes of the plans in t that only the cache holds and of the stage data blocks that only these
+    // plans use. Stage data is shared between plans through internal::dft_data_registry, so blocks
+    // that a plan outside the cache (or a loaded wisdom file) also uses are not counted
+    static size_t exclusive_memory(const table& t)
+    {
+        struct block_refs
+        {
+            size_t size;
+            long use_count;
+            long refs;
+        };
+        std::map<const u8*, block_refs> blocks;
+        size_t result = 0;
+        for (const entry_ptr& e : t)
+        {
+            if (!exclusive(*e))
+                continue;
+            result += sizeof(dft_plan<T>);
+            e->plan->for_each_data([&](const std::shared_ptr<u8>& block, size_t size) {
+                const block_refs init{ size, block.use_count(), 0 };
+                blocks.emplace(block.get(), init).first->second.refs++;
+            });
+        }
+        for (const auto& b : blocks)
+            if (b.second.refs == b.second.use_count)
+                result += b.second.size;
+        return result;
+    }
+
+    void touch(entry& e) { e.last_used.store(clock.fetch_add(1, std::memory_order_relaxed) + 1); }
+
+    plan_ptr insert(size_t size, int dir, plan_ptr plan)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unique_ptr<table> updated(new table(*current.load()));
+        const auto pos = updated->begin() + (lookup(*updated, size, dir) - updated->cbegin());
+        if (pos != updated->end() && matches(**pos, size, dir))
+        {
+            // Another thread built the same plan first
+            touch(**pos);
+            return (*pos)->plan;
+        }
+        entry_ptr e = std::make_shared<entry>();
+        e->size     = size;
+        e->dir      = dir;
+        e->plan     = plan;
+        touch(*e);
+        updated->insert(pos, e);
+        evict(*updated, e.get());
+        publish(std::move(updated));
+        return plan;
+    }
+
+    // Drops least recently used plans that only the cache holds, other than keep, until the memory
+    // held only by the cache fits in memory_limit
+    void evict(table& t, const entry* keep)
+    {
+        while (exclusive_memory(t) > memory_limit)
+        {
+            auto victim = t.end();
+            for (auto it = t.begin(); it != t.end(); ++it)
+                if (it->get() != keep && exclusive(**it) &&
+                    (victim == t.end() || (*it)->last_used < (*victim)->last_used))
+                    victim = it;
+            if (victim == t.end())
+                break;
+            t.erase(victim);
+        }
+    }
+
+    // Called with the mutex held
+    void publish(std::unique_ptr<table>&& updated)
+    {
+        retired.emplace_back(current.exchange(updated.release()));
+        if (readers.load() == 0)
+            retired.clear();
+    }
+
+    std::atomic<const table*> current;
+    mutable std::atomic<size_t> readers;
+    std::vector<std::unique_ptr<const table>> retired;
+    std::atomic<u64> clock;
+    mutable std::mutex mutex;
+    size_t memory_limit;
+};
+
+/// Returns a shared plan from the process-wide dft_plan_cache<T>
+template <typename T, bool direct = true, bool inverse = true>
+std::shared_ptr<const dft_plan<T>> get_dft_plan(size_t size, cbools_t<direct, inverse> type = dft_type::both)
+{
+    return dft_plan_cache<T>::instance().get(size, type);
+}
+}
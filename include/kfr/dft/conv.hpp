@@ -31,6 +31,14 @@
 
 #include "fft.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #pragma clang diagnostic push
 #if CID_HAS_WARNING("-Wshadow")
 #pragma clang diagnostic ignored "-Wshadow"
@@ -39,21 +47,501 @@
 namespace kfr
 {
 
+namespace internal
+{
+// acc[i] += x[i] * h[i]
+template <cpu_t cpu, typename T>
+KFR_INTRIN void spectrum_mac(ccpu_t<cpu>, complex<T>* acc, const complex<T>* x, const complex<T>* h,
+                             size_t size)
+{
+    constexpr size_t width = vector_width<T, cpu>;
+    size_t i               = 0;
+    KFR_LOOP_NOUNROLL
+    for (; i + width <= size; i += width)
+        cwrite<width>(acc + i, cread<width>(acc + i) + cmul(cread<width>(x + i), cread<width>(h + i)));
+    KFR_LOOP_NOUNROLL
+    for (; i < size; i++)
+        cwrite<1>(acc + i, cread<1>(acc + i) + cmul(cread<1>(x + i), cread<1>(h + i)));
+}
+
+// Runs jobs on worker threads, earliest deadline first. Each slot holds a fixed job that is queued
+// at most once at a time. A job that no worker has started by the time it is awaited runs on the
+// waiting thread, so results are never late because all workers are busy
+class deadline_scheduler
+{
+public:
+    deadline_scheduler(size_t slots, size_t threads) : jobs(slots), stopping(false)
+    {
+        for (size_t i = 0; i < threads; i++)
+            workers.emplace_back([this]() { worker(); });
+    }
+    deadline_scheduler(const deadline_scheduler&) = delete;
+    deadline_scheduler& operator=(const deadline_scheduler&) = delete;
+    ~deadline_scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+    }
+
+    size_t threads() const { return workers.size(); }
+
+    // Must be called before the slot is first submitted
+    void set_job(size_t slot, std::function<void()> fn) { jobs[slot].fn = std::move(fn); }
+
+    void submit(size_t slot, u64 deadline)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs[slot].deadline = deadline;
+            jobs[slot].state    = job_state::queued;
+        }
+        wakeup.notify_one();
+    }
+
+    // Returns when the job in slot is finished, immediately if it was never submitted
+    void wait(size_t slot)
+    {
+        job& j = jobs[slot];
+        std::unique_lock<std::mutex> lock(mutex);
+        if (j.state == job_state::queued)
+        {
+            j.state = job_state::running;
+            lock.unlock();
+            j.fn();
+            lock.lock();
+            j.state = job_state::idle;
+            return;
+        }
+        done.wait(lock, [&]() { return j.state == job_state::idle; });
+    }
+
+private:
+    enum class job_state
+    {
+        idle,
+        queued,
+        running
+    };
+    struct job
+    {
+        job() : deadline(0), state(job_state::idle) {}
+        std::function<void()> fn;
+        u64 deadline;
+        job_state state;
+    };
+
+    job* earliest()
+    {
+        job* result = nullptr;
+        for (job& j : jobs)
+            if (j.state == job_state::queued && (!result || j.deadline < result->deadline))
+                result = &j;
+        return result;
+    }
+
+    void worker()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            job* next = nullptr;
+            wakeup.wait(lock, [&]() { return stopping || (next = earliest()) != nullptr; });
+            if (stopping)
+                return;
+            next->state = job_state::running;
+            lock.unlock();
+            next->fn();
+            lock.lock();
+            next->state = job_state::idle;
+            done.notify_all();
+        }
+    }
+
+    std::vector<job> jobs;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable done;
+    bool stopping;
+};
+}
+
 template <typename T, size_t Tag1, size_t Tag2>
 KFR_INTRIN univector<T> convolve(const univector<T, Tag1>& src1, const univector<T, Tag2>& src2)
 {
-    const size_t size                = next_poweroftwo(src1.size() + src2.size() - 1);
-    univector<complex<T>> src1padded = src1;
-    univector<complex<T>> src2padded = src2;
+    const size_t size       = std::max(next_poweroftwo(src1.size() + src2.size() - 1), size_t(2));
+    univector<T> src1padded = src1;
+    univector<T> src2padded = src2;
     src1padded.resize(size, 0);
     src2padded.resize(size, 0);
-    dft_plan<T> plan(size);
+    univector<complex<T>> spectrum1(size / 2 + 1);
+    univector<complex<T>> spectrum2(size / 2 + 1);
+    dft_plan_real<T> plan(size);
     univector<u8> temp(plan.temp_size);
-    plan.execute(src1padded, src1padded, temp);
-    plan.execute(src2padded, src2padded, temp);
-    src1padded = src1padded * src2padded;
-    plan.execute(src1padded, src1padded, temp, true);
-    return typed<T>(real(src1padded), src1.size() + src2.size() - 1) / T(size);
+    plan.execute(spectrum1, src1padded, temp);
+    plan.execute(spectrum2, src2padded, temp);
+    spectrum1 = spectrum1 * spectrum2;
+    plan.execute(src1padded, spectrum1, temp);
+    return typed<T>(src1padded, src1.size() + src2.size() - 1) / T(size);
 }
+
+// Streaming convolution of an unbounded signal with a fixed kernel (overlap-save)
+// Input is buffered until a block is complete, so each block costs one forward/inverse FFT pair
+// whatever the call sizes. Output is delayed by latency() = block_size samples: out[i] is the
+// (i - block_size)-th sample of the linear convolution of everything passed to process since
+// construction or reset, and zero before that. process never allocates
+template <typename T>
+struct fft_convolver
+{
+    size_t kernel_size;
+    size_t fft_size;
+    // Input samples per forward/inverse FFT pair
+    size_t block_size;
+
+    // typical_block is the usual number of samples per process call, block_size is at least typical_block
+    template <size_t Tag>
+    fft_convolver(const univector<T, Tag>& kernel, size_t typical_block = 0)
+        : kernel_size(std::max(kernel.size(), size_t(1))),
+          fft_size(
+              std::max(next_poweroftwo(kernel_size - 1 + std::max(typical_block, kernel_size)), size_t(2))),
+          block_size(fft_size - kernel_size + 1), plan(fft_size), kernel_spectrum(fft_size / 2 + 1),
+          spectrum(fft_size / 2 + 1), segment(fft_size), result(fft_size), temp(plan.temp_size), position(0)
+    {
+        // The inverse FFT is unnormalized, fold 1/fft_size into the kernel
+        univector<T> padded(fft_size, T());
+        std::copy(kernel.begin(), kernel.end(), padded.begin());
+        padded = padded / T(fft_size);
+        plan.execute(kernel_spectrum, padded, temp);
+        reset();
+    }
+
+    size_t latency() const { return block_size; }
+
+    // Clears the history, the next sample passed to process is treated as the first one
+    void reset()
+    {
+        std::fill(segment.begin(), segment.end(), T());
+        std::fill(result.begin(), result.end(), T());
+        position = 0;
+    }
+
+    // out and in may point to the same buffer
+    void process(T* out, const T* in, size_t size)
+    {
+        const size_t history = kernel_size - 1;
+        while (size > 0)
+        {
+            const size_t count = std::min(size, block_size - position);
+            std::copy(in, in + count, segment.data() + history + position);
+            std::copy(result.data() + history + position, result.data() + history + position + count, out);
+
+            position += count;
+            in += count;
+            out += count;
+            size -= count;
+            if (position == block_size)
+            {
+                plan.execute(spectrum, segment, temp);
+                spectrum = spectrum * kernel_spectrum;
+                plan.execute(result, spectrum, temp);
+                std::copy(segment.data() + block_size, segment.data() + fft_size, segment.data());
+                position = 0;
+            }
+        }
+    }
+
+    template <size_t Tag1, size_t Tag2>
+    void process(univector<T, Tag1>& out, const univector<T, Tag2>& in)
+    {
+        process(out.data(), in.data(), std::min(out.size(), in.size()));
+    }
+
+private:
+    dft_plan_real<T> plan;
+    univector<complex<T>> kernel_spectrum;
+    univector<complex<T>> spectrum;
+    // kernel_size - 1 samples of history followed by block_size samples of the current block
+    univector<T> segment;
+    // Output of the previous block from kernel_size - 1 on
+    univector<T> result;
+    univector<u8> temp;
+    size_t position;
+};
+
+// Uniformly partitioned convolution with a frequency-domain delay line (UPOLS)
+// The kernel is split into partitions of block_size samples. A block of input costs one forward
+// and one inverse FFT of 2 * block_size points and a complex multiply-add per partition whatever
+// the call sizes, so latency is bounded by block_size for any kernel length. Like fft_convolver,
+// process delays the output by latency() = block_size samples. process never allocates
+template <typename T>
+struct fft_partitioned_convolver
+{
+    size_t kernel_size;
+    size_t block_size;
+    size_t partitions;
+
+    // block is rounded up to a power of two
+    template <typename U, size_t Tag>
+    fft_partitioned_convolver(const univector<U, Tag>& kernel, size_t block = 256)
+        : kernel_size(std::max(kernel.size(), size_t(1))),
+          block_size(std::max(next_poweroftwo(block), size_t(2))),
+          partitions((kernel_size + block_size - 1) / block_size), bins(block_size + 1),
+          plan(block_size * 2), kernel_spectra(partitions * bins), delay_line(partitions * bins),
+          spectrum(bins), segment(block_size * 2), result(block_size * 2), temp(plan.temp_size), current(0),
+          position(0)
+    {
+        // Each partition is zero-padded to the FFT size, 1/(2 * block_size) is folded into the kernel
+        univector<T> padded(block_size * 2);
+        for (size_t p = 0; p < partitions; p++)
+        {
+            const size_t offset = p * block_size;
+            const size_t count  = std::min(block_size, kernel.size() - std::min(offset, kernel.size()));
+            std::fill(padded.begin(), padded.end(), T());
+            std::copy(kernel.data() + offset, kernel.data() + offset + count, padded.data());
+            padded = padded / T(block_size * 2);
+            plan.execute(kernel_spectra.data() + p * bins, padded.data(), temp.data());
+        }
+        reset();
+    }
+
+    size_t latency() const { return block_size; }
+
+    // Clears the history, the next sample passed to process is treated as the first one
+    void reset()
+    {
+        std::fill(segment.begin(), segment.end(), T());
+        std::fill(result.begin(), result.end(), T());
+        std::fill(delay_line.begin(), delay_line.end(), complex<T>());
+        current  = 0;
+        position = 0;
+    }
+
+    // out and in may point to the same buffer
+    void process(T* out, const T* in, size_t size)
+    {
+        while (size > 0)
+        {
+            const size_t count = std::min(size, block_size - position);
+            std::copy(in, in + count, segment.data() + block_size + position);
+            std::copy(result.data() + block_size + position, result.data() + block_size + position + count,
+                      out);
+
+            position += count;
+            in += count;
+            out += count;
+            size -= count;
+            if (position == block_size)
+                next_block();
+        }
+    }
+
+    template <size_t Tag1, size_t Tag2>
+    void process(univector<T, Tag1>& out, const univector<T, Tag2>& in)
+    {
+        process(out.data(), in.data(), std::min(out.size(), in.size()));
+    }
+
+    // Processes one whole block of block_size samples without latency: out[i] is the sample of the
+    // convolution at in[i]. For callers that always pass whole blocks, don't mix with process
+    void process_block(T* out, const T* in)
+    {
+        std::copy(in, in + block_size, segment.data() + block_size);
+        next_block();
+        std::copy(result.data() + block_size, result.data() + block_size * 2, out);
+    }
+
+private:
+    // Transforms the complete current block and starts the next one
+    void next_block()
+    {
+        complex<T>* current_spectrum = delay_line.data() + current * bins;
+        plan.execute(current_spectrum, segment.data(), temp.data());
+        std::fill(spectrum.begin(), spectrum.end(), complex<T>());
+        internal::call_for_cpu(plan.choice().cpu, [&](auto cpu) KFR_INLINE_LAMBDA {
+            for (size_t p = 0; p < partitions; p++)
+            {
+                const size_t index = (current + partitions - p) % partitions;
+                internal::spectrum_mac(cpu, spectrum.data(), delay_line.data() + index * bins,
+                                       kernel_spectra.data() + p * bins, bins);
+            }
+        });
+        plan.execute(result.data(), spectrum.data(), temp.data());
+
+        std::copy(segment.data() + block_size, segment.data() + block_size * 2, segment.data());
+        current  = current + 1 == partitions ? 0 : current + 1;
+        position = 0;
+    }
+
+    size_t bins;
+    dft_plan_real<T> plan;
+    univector<complex<T>> kernel_spectra;
+    // Spectra of the last partitions input segments, current is the slot of the block being filled
+    univector<complex<T>> delay_line;
+    univector<complex<T>> spectrum;
+    // Previous block followed by the current one
+    univector<T> segment;
+    // Output of the previous block from block_size on
+    univector<T> result;
+    univector<u8> temp;
+    size_t current;
+    size_t position;
+};
+
+// Non-uniformly partitioned convolution for very long kernels
+// The head of the kernel runs in an fft_partitioned_convolver with head_block partitions on the
+// calling thread, so the output is delayed by latency() = head_block samples. The rest is split
+// into tail stages whose block size grows 4x per stage up to max_block. A stage with block B
+// covers kernel samples [2B - head_block, 8B - head_block) and processes each full input block on
+// a worker thread: the result is needed one block after the job starts, which is its deadline.
+// So the calling thread pays small-block latency while the total cost per sample grows only
+// logarithmically with the kernel length.
+// With threads = 0 tail stages run on the calling thread at their block boundaries
+template <typename T>
+struct fft_nonuniform_convolver
+{
+    size_t kernel_size;
+    size_t head_block;
+
+    template <size_t Tag>
+    fft_nonuniform_convolver(const univector<T, Tag>& kernel, size_t head_block = 64,
+                             size_t max_block = 16384, size_t threads = 1)
+        : kernel_size(std::max(kernel.size(), size_t(1))),
+          head_block(std::max(next_poweroftwo(head_block), size_t(2))),
+          head(kernel.slice(0, std::min(head_span(this->head_block, max_block), kernel.size())),
+               this->head_block),
+          position(0)
+    {
+        max_block    = std::max(next_poweroftwo(max_block), this->head_block);
+        size_t block = std::min(this->head_block * 4, max_block);
+        size_t begin = 2 * block - this->head_block;
+        while (begin < kernel.size())
+        {
+            const size_t next = std::min(block * 4, max_block);
+            const size_t end =
+                next == block ? kernel.size() : std::min(kernel.size(), 2 * next - this->head_block);
+            stages.emplace_back(new stage(kernel.slice(begin, end - begin), block));
+            begin = end;
+            block = next;
+        }
+
+        scheduler.reset(new internal::deadline_scheduler(stages.size(), stages.empty() ? 0 : threads));
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            stage* s = stages[i].get();
+            scheduler->set_job(i, [s]() { s->conv.process_block(s->task_out.data(), s->task_in.data()); });
+        }
+    }
+
+    size_t latency() const { return head_block; }
+
+    // Number of stages running on worker threads
+    size_t tail_stages() const { return stages.size(); }
+
+    // Waits for background jobs and clears the history
+    void reset()
+    {
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            scheduler->wait(i);
+            stages[i]->reset();
+        }
+        head.reset();
+        position = 0;
+    }
+
+    // Must be called from one thread at a time. out and in may point to the same buffer
+    void process(T* out, const T* in, size_t size)
+    {
+        while (size > 0)
+        {
+            size_t count = size;
+            for (const auto& s : stages)
+                count = std::min(count, s->block - s->position);
+
+            // Stages read the input before the head overwrites it when out == in
+            for (const auto& s : stages)
+                std::copy(in, in + count, s->input.data() + s->position);
+            head.process(out, in, count);
+            position += count;
+
+            univector_ref<T> result = make_univector(out, count);
+            for (size_t i = 0; i < stages.size(); i++)
+            {
+                stage& s = *stages[i];
+                result   = result + s.ready.slice(s.position, count);
+                s.position += count;
+                if (s.position == s.block)
+                    next_block(i);
+            }
+            in += count;
+            out += count;
+            size -= count;
+        }
+    }
+
+    template <size_t Tag1, size_t Tag2>
+    void process(univector<T, Tag1>& out, const univector<T, Tag2>& in)
+    {
+        process(out.data(), in.data(), std::min(out.size(), in.size()));
+    }
+
+private:
+    struct stage
+    {
+        template <size_t Tag>
+        stage(const univector<const T, Tag>& segment, size_t block)
+            : block(block), conv(segment, block), input(block), task_in(block), task_out(block), ready(block)
+        {
+            reset();
+        }
+        void reset()
+        {
+            conv.reset();
+            std::fill(task_out.begin(), task_out.end(), T());
+            std::fill(ready.begin(), ready.end(), T());
+            position = 0;
+        }
+
+        size_t block;
+        fft_partitioned_convolver<T> conv;
+        // Block being filled, block being processed and output of the block before the previous one
+        univector<T> input;
+        univector<T> task_in;
+        univector<T> task_out;
+        univector<T> ready;
+        size_t position;
+    };
+
+    // Kernel samples covered by the head, up to the first stage
+    static size_t head_span(size_t head_block, size_t max_block)
+    {
+        return 2 * std::min(head_block * 4, std::max(next_poweroftwo(max_block), head_block)) - head_block;
+    }
+
+    // Called when stage i has received a full block. Output for the block that starts now is the
+    // stage output for the block before the previous one, so the stage delays its input by 2 * block,
+    // which is head_block more than the kernel offset of the stage
+    void next_block(size_t i)
+    {
+        stage& s = *stages[i];
+        scheduler->wait(i);
+        s.ready.swap(s.task_out);
+        s.input.swap(s.task_in);
+        s.position = 0;
+        scheduler->submit(i, position + s.block);
+    }
+
+    fft_partitioned_convolver<T> head;
+    std::vector<std::unique_ptr<stage>> stages;
+    // Samples processed since the last reset, used as the time base for deadlines
+    u64 position;
+    // Declared last so that workers are joined before the stages are destroyed
+    std::unique_ptr<internal::deadline_scheduler> scheduler;
+};
 }
 #pragma clang diagnostic pop
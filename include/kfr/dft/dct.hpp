@@ -0,0 +1,333 @@
+/**
+ * Copyright (C) 2016 D Levin (http://www.kfrlib.com)
+ * This file is part of KFR
+ *
+ * KFR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KFR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KFR.
+ *
+ * If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+ * Buying a commercial license is mandatory as soon as you develop commercial activities without
+ * disclosing the source code of your own applications.
+ * See http://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "../expressions/operators.hpp"
+#include "fft.hpp"
+
+#include <memory>
+
+namespace kfr
+{
+
+enum class dct_type
+{
+    II,  // y[k] = 2 sum x[n] cos(pi (2n + 1) k / 2N)
+    III, // y[n] = x[0] + 2 sum(k > 0) x[k] cos(pi (2n + 1) k / 2N), inverse of II up to 2N
+    IV   // y[k] = 2 sum x[n] cos(pi (2n + 1) (2k + 1) / 4N), its own inverse up to 2N
+};
+
+enum class dst_type
+{
+    II, // y[k] = 2 sum x[n] sin(pi (2n + 1) (k + 1) / 2N)
+    III // y[n] = (-1)^n x[N - 1] + 2 sum(k < N - 1) x[k] sin(pi (2n + 1) (k + 1) / 2N),
+        // inverse of II up to 2N
+};
+
+/// Discrete cosine transforms of even size with the unnormalized FFTW (REDFTxx) definitions.
+/// II and III run a real FFT of size points, which is a size / 2 point complex FFT, IV runs a
+/// size / 2 point complex FFT directly. The input permutation and the pre/post twiddles are single
+/// passes around the FFT, so a DCT costs about as much as a real FFT of the same size.
+/// Odd sizes and 0 give an empty plan with size 0, whose execute does nothing
+template <typename T>
+struct dct_plan
+{
+    size_t size;
+    dct_type type;
+    size_t temp_size;
+
+    dct_plan(size_t size, dct_type type = dct_type::II)
+        : size(size % 2 == 0 ? size : 0), type(type), temp_size(0)
+    {
+        const size_t half = this->size / 2;
+        buffer_size       = align_up(sizeof(complex<T>) * (half + 1), native_cache_alignment);
+        if (this->size == 0)
+            return;
+        switch (type)
+        {
+        case dct_type::II:
+            // 2 exp(-i pi k / 2N)
+            real_plan.reset(new dft_plan_real<T>(size));
+            twiddle.resize(half + 1);
+            internal::fill_twiddles(twiddle.data(), half + 1, 1, size * 4, real_plan->choice().cpu);
+            twiddle   = twiddle * T(2);
+            temp_size = buffer_size * 2 + real_plan->temp_size;
+            break;
+        case dct_type::III:
+            // exp(i pi k / 2N)
+            real_plan.reset(new dft_plan_real<T>(size));
+            twiddle.resize(half + 1);
+            internal::fill_twiddles(twiddle.data(), half + 1, 1, size * 4, real_plan->choice().cpu);
+            for (complex<T>& tw : twiddle)
+                tw = complex<T>(tw.real(), -tw.imag());
+            temp_size = buffer_size * 2 + real_plan->temp_size;
+            break;
+        case dct_type::IV:
+            // exp(-i pi (4n + 1) / 4N) before and 2 exp(-i pi k / N) after the FFT
+            pre_twiddle.resize(half);
+            for (size_t n = 0; n < half; n++)
+            {
+                const cvec<T, 1> tw = internal::calculate_twiddle<T>(4 * n + 1, size * 8);
+                pre_twiddle[n]      = complex<T>(tw[0], tw[1]);
+            }
+            complex_plan.reset(new dft_plan<T>(half));
+            twiddle.resize(half);
+            internal::fill_twiddles(twiddle.data(), half, 1, size * 2, complex_plan->choice.cpu);
+            twiddle   = twiddle * T(2);
+            temp_size = buffer_size + complex_plan->temp_size;
+            break;
+        }
+    }
+
+    // out may be equal to in
+    void execute(T* out, const T* in, u8* temp) const
+    {
+        if (size == 0)
+            return;
+        switch (type)
+        {
+        case dct_type::II:
+            execute_dct2(out, in, temp);
+            break;
+        case dct_type::III:
+            execute_dct3(out, in, temp);
+            break;
+        case dct_type::IV:
+            execute_dct4(out, in, temp);
+            break;
+        }
+    }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    void execute(univector<T, Tag1>& out, const univector<T, Tag2>& in, univector<u8, Tag3>& temp) const
+    {
+        execute(out.data(), in.data(), temp.data());
+    }
+
+private:
+    size_t buffer_size;
+    // Only the plan used by the type is built
+    std::unique_ptr<dft_plan_real<T>> real_plan;
+    std::unique_ptr<dft_plan<T>> complex_plan;
+    univector<complex<T>> twiddle;
+    univector<complex<T>> pre_twiddle;
+
+    // x[i] *= w[i] at the instruction set of the FFT
+    void multiply(complex<T>* x, const complex<T>* w, size_t count) const
+    {
+        const cpu_t cpu = real_plan ? real_plan->choice().cpu : complex_plan->choice.cpu;
+        internal::call_for_cpu(cpu, [&](auto c) KFR_INLINE_LAMBDA {
+            internal::complex_multiply(c, cfalse, x, x, w, count);
+        });
+    }
+
+    // Makhoul: v = x[0], x[2], ..., x[3], x[1], then y[k] = Re(2 exp(-i pi k / 2N) V[k]) and
+    // y[N - k] = -Im(2 exp(-i pi k / 2N) V[k])
+    void execute_dct2(T* out, const T* in, u8* temp) const
+    {
+        const size_t half    = size / 2;
+        T* v                 = ptr_cast<T>(temp);
+        complex<T>* spectrum = ptr_cast<complex<T>>(temp + buffer_size);
+        for (size_t n = 0; n < half; n++)
+        {
+            v[n]            = in[2 * n];
+            v[size - 1 - n] = in[2 * n + 1];
+        }
+        real_plan->execute(spectrum, v, temp + buffer_size * 2);
+        multiply(spectrum, twiddle.data(), half + 1);
+        out[0] = spectrum[0].real();
+        for (size_t k = 1; k < half; k++)
+        {
+            out[k]        = spectrum[k].real();
+            out[size - k] = -spectrum[k].imag();
+        }
+        out[half] = spectrum[half].real();
+    }
+
+    // Inverse of the above: V[k] = exp(i pi k / 2N) (x[k] - i x[N - k]), which is Hermitian, and
+    // the unnormalized real inverse FFT of V holds y in the same order as v above
+    void execute_dct3(T* out, const T* in, u8* temp) const
+    {
+        const size_t half    = size / 2;
+        T* v                 = ptr_cast<T>(temp);
+        complex<T>* spectrum = ptr_cast<complex<T>>(temp + buffer_size);
+        spectrum[0]          = complex<T>(in[0], 0);
+        for (size_t k = 1; k <= half; k++)
+            spectrum[k] = complex<T>(in[k], -in[size - k]);
+        multiply(spectrum, twiddle.data(), half + 1);
+        real_plan->execute(v, spectrum, temp + buffer_size * 2);
+        for (size_t n = 0; n < half; n++)
+        {
+            out[2 * n]     = v[n];
+            out[2 * n + 1] = v[size - 1 - n];
+        }
+    }
+
+    // u[n] = (x[2n] + i x[N - 1 - 2n]) exp(-i pi (4n + 1) / 4N), U = FFT(u), then
+    // y[2k] = Re(2 exp(-i pi k / N) U[k]) and y[N - 1 - 2k] = -Im(2 exp(-i pi k / N) U[k])
+    void execute_dct4(T* out, const T* in, u8* temp) const
+    {
+        const size_t half = size / 2;
+        complex<T>* u     = ptr_cast<complex<T>>(temp);
+        for (size_t n = 0; n < half; n++)
+            u[n] = complex<T>(in[2 * n], in[size - 1 - 2 * n]);
+        multiply(u, pre_twiddle.data(), half);
+        complex_plan->execute(u, u, temp + buffer_size);
+        multiply(u, twiddle.data(), half);
+        for (size_t k = 0; k < half; k++)
+        {
+            out[2 * k]            = u[k].real();
+            out[size - 1 - 2 * k] = -u[k].imag();
+        }
+    }
+};
+
+/// Discrete sine transforms with the unnormalized FFTW (RODFTxx) definitions, computed by a DCT of
+/// the same type: DST-II is the reversed DCT-II of the input with odd samples negated, DST-III negates
+/// the odd samples of the DCT-III of the reversed input.
+/// Odd sizes and 0 give an empty plan with size 0, whose execute does nothing
+template <typename T>
+struct dst_plan
+{
+    size_t size;
+    dst_type type;
+    size_t temp_size;
+
+    dst_plan(size_t size, dst_type type = dst_type::II)
+        : size(size % 2 == 0 ? size : 0), type(type), temp_size(0),
+          dct(this->size, type == dst_type::II ? dct_type::II : dct_type::III),
+          buffer_size(align_up(sizeof(T) * this->size, native_cache_alignment))
+    {
+        temp_size = buffer_size + dct.temp_size;
+    }
+
+    // out may be equal to in
+    void execute(T* out, const T* in, u8* temp) const
+    {
+        if (size == 0)
+            return;
+        T* u = ptr_cast<T>(temp);
+        if (type == dst_type::II)
+        {
+            for (size_t n = 0; n < size; n += 2)
+            {
+                u[n]     = in[n];
+                u[n + 1] = -in[n + 1];
+            }
+            dct.execute(u, u, temp + buffer_size);
+            for (size_t k = 0; k < size; k++)
+                out[k] = u[size - 1 - k];
+        }
+        else
+        {
+            for (size_t k = 0; k < size; k++)
+                u[k] = in[size - 1 - k];
+            dct.execute(u, u, temp + buffer_size);
+            for (size_t n = 0; n < size; n += 2)
+            {
+                out[n]     = u[n];
+                out[n + 1] = -u[n + 1];
+            }
+        }
+    }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    void execute(univector<T, Tag1>& out, const univector<T, Tag2>& in, univector<u8, Tag3>& temp) const
+    {
+        execute(out.data(), in.data(), temp.data());
+    }
+
+private:
+    dct_plan<T> dct;
+    size_t buffer_size;
+};
+
+/// Modified discrete cosine transform of 2 * size samples into size coefficients (size even),
+/// y[k] = sum x[n] cos(pi / size (n + 1/2 + size/2) (k + 1/2)), and its inverse
+/// x[n] = sum y[k] cos(pi / size (n + 1/2 + size/2) (k + 1/2)), which is the time-aliased signal
+/// that windowed overlap-add turns back into the input (TDAC).
+/// Both fold the data into a DCT-IV of size points, a size / 2 point complex FFT.
+/// Odd sizes and 0 give an empty plan with size 0, whose execute does nothing
+template <typename T>
+struct mdct_plan
+{
+    size_t size;
+    size_t temp_size;
+
+    mdct_plan(size_t size)
+        : size(size % 2 == 0 ? size : 0), temp_size(0), dct(this->size, dct_type::IV),
+          buffer_size(align_up(sizeof(T) * this->size, native_cache_alignment))
+    {
+        temp_size = buffer_size + dct.temp_size;
+    }
+
+    // Forward: in holds 2 * size samples and out receives size coefficients
+    // Inverse: in holds size coefficients and out receives 2 * size samples
+    void execute(T* out, const T* in, u8* temp, bool inverse = false) const
+    {
+        if (size == 0)
+            return;
+        const size_t half = size / 2;
+        T* u              = ptr_cast<T>(temp);
+        if (!inverse)
+        {
+            // Quarters (a, b, c, d) fold to (-c_r - d, a - b_r) / 2, the DCT-IV is scaled by 2
+            const T* a = in;
+            const T* b = in + half;
+            const T* c = in + size;
+            const T* d = in + size + half;
+            for (size_t i = 0; i < half; i++)
+            {
+                u[i]        = (-c[half - 1 - i] - d[i]) * T(0.5);
+                u[half + i] = (a[i] - b[half - 1 - i]) * T(0.5);
+            }
+            dct.execute(out, u, temp + buffer_size);
+        }
+        else
+        {
+            // DCT-IV halves (w1, w2) / 2 unfold to (w2, -w2_r, -w1_r, -w1)
+            dct.execute(u, in, temp + buffer_size);
+            const T* w1 = u;
+            const T* w2 = u + half;
+            for (size_t i = 0; i < half; i++)
+            {
+                out[i]               = w2[i] * T(0.5);
+                out[half + i]        = -w2[half - 1 - i] * T(0.5);
+                out[size + i]        = -w1[half - 1 - i] * T(0.5);
+                out[size + half + i] = -w1[i] * T(0.5);
+            }
+        }
+    }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    void execute(univector<T, Tag1>& out, const univector<T, Tag2>& in, univector<u8, Tag3>& temp,
+                 bool inverse = false) const
+    {
+        execute(out.data(), in.data(), temp.data(), inverse);
+    }
+
+private:
+    dct_plan<T> dct;
+    size_t buffer_size;
+};
+}
@@ -24,12 +24,22 @@
 
 #include "../base/complex.hpp"
 #include "../base/constants.hpp"
+#include "../base/dispatch.hpp"
+#include "../base/log_exp.hpp"
 #include "../base/memory.hpp"
 #include "../base/read_write.hpp"
+#include "../base/sqrt.hpp"
 #include "../base/vec.hpp"
 #include "../misc/small_buffer.hpp"
+#include "../misc/threadpool.hpp"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <tuple>
 
 #include "../cometa/string.hpp"
+#include "../dispatch/cpuid_auto.hpp"
 
 #include "bitrev.hpp"
 #include "ft.hpp"
@@ -42,6 +52,19 @@
 namespace kfr
 {
 
+/// Known zeros of the input and unused bins of the output of a forward transform.
+/// Power-of-two plans with radix-4 stages (sizes above 256) skip the butterflies that only read zeros or only
+/// feed unused bins, other plans compute the whole transform
+struct dft_pruning
+{
+    size_t input_size;   // input elements from input_size on are zero
+    size_t output_begin; // only bins [output_begin, output_end) are computed, other bins are unspecified
+    size_t output_end;
+};
+
+template <typename T>
+struct dft_plan;
+
 template <typename T>
 struct dft_stage
 {
@@ -52,16 +75,34 @@ struct dft_stage
     size_t repeats    = 1;
     size_t out_offset = 0;
     const char* name;
+    std::string data_name; // layout of the stage data, see internal::dft_data_name
     bool recursion = false;
 
-    void initialize(size_t size) { do_initialize(size); }
+    // pool may be null, it's used to fill large tables on all cores
+    void initialize(size_t size, thread_pool* pool = nullptr)
+    {
+        this->pool = pool;
+        do_initialize(size);
+        this->pool = nullptr;
+    }
 
     KFR_INTRIN void execute(complex<T>* out, const complex<T>* in, u8* temp) { do_execute(out, in, temp); }
+    // Pruned stages need the offset of the block from the start of the transform, other stages ignore it
+    KFR_INTRIN void execute(complex<T>* out, const complex<T>* in, u8* temp, size_t offset)
+    {
+        do_execute(out, in, temp, offset);
+    }
     virtual ~dft_stage() {}
 
 protected:
+    thread_pool* pool = nullptr; // set while do_initialize runs
+
     virtual void do_initialize(size_t) {}
     virtual void do_execute(complex<T>*, const complex<T>*, u8* temp) = 0;
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp, size_t /*offset*/)
+    {
+        do_execute(out, in, temp);
+    }
 };
 
 #pragma clang diagnostic push
@@ -72,6 +113,124 @@ protected:
 namespace internal
 {
 
+// Name of a stage data layout. Stages with equal names, stage_size and data_size compute identical data
+// whatever their direction, input format, prefetching or the size of the plan they belong to: twiddles
+// of a stage only depend on its own size, so the inner stages of a plan are shared with smaller plans
+template <typename T>
+inline std::string dft_data_name(const std::string& layout, size_t width)
+{
+    return layout + " " + type_name<T>() + " x" + std::to_string(width);
+}
+
+// Precomputed stage data shared by all plans.
+// Blocks are keyed by the data layout, so both directions of a plan, its prefetching and pruned variants,
+// other plans of the same size and element type and the stages of larger plans of the same size point
+// to one block.
+// Blocks are released when the last plan using them is destroyed
+class dft_data_registry
+{
+public:
+    static dft_data_registry& instance()
+    {
+        static dft_data_registry registry;
+        return registry;
+    }
+
+    // Returns the block for the stage, calling init(block) to fill a newly allocated one
+    template <typename Fn>
+    std::shared_ptr<u8> get(const std::string& name, size_t stage_size, size_t data_size, Fn&& init)
+    {
+        const block_key key(name, stage_size, data_size);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = blocks.find(key);
+            if (it != blocks.end())
+                if (std::shared_ptr<u8> block = it->second.lock())
+                    return block;
+        }
+        // Filled outside the lock, large tables take a while
+        std::shared_ptr<u8> block(aligned_allocate<u8>(data_size), aligned_deleter<u8>());
+        init(block.get());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::weak_ptr<u8>& entry = blocks[key];
+        if (std::shared_ptr<u8> existing = entry.lock())
+            return existing;
+        entry = block;
+        for (auto it = blocks.begin(); it != blocks.end();)
+            it = it->second.expired() ? blocks.erase(it) : std::next(it);
+        return block;
+    }
+
+    // Registers an externally owned block (e.g. mapped from a file) unless an equal block is in use
+    void insert(const std::string& name, size_t stage_size, size_t data_size,
+                const std::shared_ptr<u8>& block)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::weak_ptr<u8>& entry = blocks[block_key(name, stage_size, data_size)];
+        if (entry.expired())
+            entry = block;
+    }
+
+    // Calls fn(name, stage_size, data_size, block) for every block in use
+    template <typename Fn>
+    void for_each(Fn&& fn)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& it : blocks)
+            if (std::shared_ptr<u8> block = it.second.lock())
+                fn(std::get<0>(it.first), std::get<1>(it.first), std::get<2>(it.first), block);
+    }
+
+private:
+    using block_key = std::tuple<std::string, size_t, size_t>;
+    std::mutex mutex;
+    std::map<block_key, std::weak_ptr<u8>> blocks;
+};
+
+// Base for stages built for a specific cpu.
+// The derived execute_impl is inlined into a function compiled for that instruction set
+template <typename T, cpu_t cpu, typename Derived>
+struct dft_stage_cpu : dft_stage<T>
+{
+protected:
+    using dft_stage<T>::do_execute;
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp) override final
+    {
+        Derived* stage = static_cast<Derived*>(this);
+        cpu_caller<cpu>::call([stage](complex<T>* out, const complex<T>* in, u8* temp)
+                                  KFR_INLINE_LAMBDA { stage->execute_impl(out, in, temp); },
+                              out, in, temp);
+    }
+};
+
+// Base for pruned stages (see dft_pruning), whose execute_impl also takes the offset of the block
+template <typename T, cpu_t cpu, typename Derived>
+struct dft_pruned_stage_cpu : dft_stage<T>
+{
+protected:
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp) override final
+    {
+        do_execute(out, in, temp, 0);
+    }
+    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* temp, size_t offset) override final
+    {
+        Derived* stage = static_cast<Derived*>(this);
+        cpu_caller<cpu>::call([stage](complex<T>* out, const complex<T>* in, u8* temp, size_t offset)
+                                  KFR_INLINE_LAMBDA { stage->execute_impl(out, in, temp, offset); },
+                              out, in, temp, offset);
+    }
+};
+
+// Calls fn(ccpu<c>) from a function compiled for c, the newest instruction set of cpu_all supported by
+// cpu, as dft_plan selects its stages. fn must be inlined and use vector_width<T, c>
+template <typename Fn>
+KFR_INTRIN void call_for_cpu(cpu_t cpu, Fn&& fn)
+{
+    auto call = [&](auto c) { cpu_caller<val_of(c)>::call([&]() KFR_INLINE_LAMBDA { fn(c); }); };
+    cswitch(cpu_all, cpu, call, [&]() { call(ccpu<cpu_all.back()>); }, fn_is_greaterorequal());
+}
+
 template <size_t width, bool inverse, typename T>
 KFR_INTRIN cvec<T, width> radix4_apply_twiddle(csize_t<width>, cfalse_t /*split_format*/, cbool_t<inverse>,
                                                cvec<T, width> w, cvec<T, width> tw)
@@ -193,46 +352,131 @@ KFR_INTRIN void radix4_body(size_t N, csize_t<width>, ctrue_t, cbool_t<splitout>
                                                                    cread<width, true>(twiddle + width * 2)));
 }
 
-template <typename T>
-KFR_NOINLINE cvec<T, 1> calculate_twiddle(size_t n, size_t size)
+// Twiddles exp(-2pi*i*k/size) for k = n + step * i, i in [0, width), computed in double precision.
+// Each angle is folded into the first octant and the result is unfolded by symmetry,
+// so sin and cos are only evaluated on [0, pi/4] and the quarter-period values are exact
+template <typename T, size_t width>
+KFR_INTRIN cvec<T, width> calculate_twiddles(size_t n, size_t step, size_t size)
 {
-    if (n == 0)
-    {
-        return make_vector(static_cast<T>(1), static_cast<T>(0));
-    }
-    else if (n == size / 4)
+    vec<f64, width> phi;
+    vec<f64, width> swap;
+    vec<f64, width> re_sign;
+    vec<f64, width> im_sign;
+    KFR_LOOP_UNROLL
+    for (size_t i = 0; i < width; i++)
     {
-        return make_vector(static_cast<T>(0), static_cast<T>(-1));
+        const size_t m   = (n + step * i) % size * 8;
+        const size_t oct = m / size;
+        const size_t r   = oct % 2 ? size - m % size : m % size;
+        phi(i)           = c_pi<f64, 1, 4> * (r / static_cast<f64>(size));
+        swap(i)          = (oct + 1) & 2 ? 1.0 : 0.0;
+        re_sign(i)       = (oct + 2) & 4 ? -1.0 : 1.0;
+        im_sign(i)       = oct & 4 ? 1.0 : -1.0;
     }
-    else if (n == size / 2)
+    const vec<f64, width> c = native::cos(phi);
+    const vec<f64, width> s = native::sin(phi);
+    return cast<T>(interleave(select(swap > f64(), s, c) * re_sign, select(swap > f64(), c, s) * im_sign));
+}
+
+template <typename T>
+KFR_NOINLINE cvec<T, 1> calculate_twiddle(size_t n, size_t size)
+{
+    return calculate_twiddles<T, 1>(n, 0, size);
+}
+
+// First octant of the twiddles exp(-2pi*i*k/size) for size divisible by 8: cos and sin of 2pi*j/size
+// for j in [0, size/8], computed in double precision. Any other twiddle of the period is one of these
+// with the parts swapped and negated, so a table of twiddles evaluates sin and cos for an eighth of it.
+// The values are equal to those of calculate_twiddles
+template <typename T, cpu_t cpu>
+struct twiddle_octant
+{
+    explicit twiddle_octant(size_t size)
+        : size(size), eighth(size / 8), cos_table(align_up(eighth + 1, width)), sin_table(cos_table.size())
     {
-        return make_vector(static_cast<T>(-1), static_cast<T>(0));
+        cpu_caller<cpu>::call([this]() KFR_INLINE_LAMBDA {
+            KFR_LOOP_NOUNROLL
+            for (size_t j = 0; j <= eighth; j += width)
+            {
+                vec<f64, width> phi;
+                KFR_LOOP_UNROLL
+                for (size_t i = 0; i < width; i++)
+                    phi(i) = c_pi<f64, 1, 4> * ((j + i) * 8 / static_cast<f64>(this->size));
+                write(cos_table.data() + j, native::cos(phi));
+                write(sin_table.data() + j, native::sin(phi));
+            }
+        });
     }
-    else if (n == size * 3 / 4)
+
+    // Twiddles for k = n + step * i, i in [0, N)
+    template <size_t N>
+    KFR_INTRIN cvec<T, N> get(size_t n, size_t step) const
     {
-        return make_vector(static_cast<T>(0), static_cast<T>(1));
+        cvec<T, N> result;
+        KFR_LOOP_UNROLL
+        for (size_t i = 0; i < N; i++)
+        {
+            const size_t k    = (n + step * i) % size;
+            const size_t oct  = k / eighth;
+            const size_t j    = oct % 2 ? eighth - k % eighth : k % eighth;
+            const f64 c       = (oct + 1) & 2 ? sin_table[j] : cos_table[j];
+            const f64 s       = (oct + 1) & 2 ? cos_table[j] : sin_table[j];
+            result(i * 2)     = static_cast<T>(c * ((oct + 2) & 4 ? -1.0 : 1.0));
+            result(i * 2 + 1) = static_cast<T>(s * (oct & 4 ? 1.0 : -1.0));
+        }
+        return result;
     }
-    else
+
+private:
+    constexpr static size_t width = vector_width<f64, cpu>;
+    size_t size;
+    size_t eighth;
+    std::vector<f64> cos_table;
+    std::vector<f64> sin_table;
+};
+
+// out[i] = exp(-2pi*i * i * step / size) for i in [0, count)
+template <typename T, cpu_t cpu>
+KFR_INTRIN void fill_twiddles(complex<T>* out, size_t count, size_t step, size_t size)
+{
+    constexpr size_t width = vector_width<T, cpu>;
+    // The table repeats with the period size / step, use the octant when it is shorter than the table
+    const bool periodic = size % step == 0;
+    const size_t period = periodic ? size / step : size;
+    if (period % 8 == 0 && period / 8 < count)
     {
-        double kth  = c_pi<double, 2> * (n / static_cast<double>(size));
-        double tcos = +kfr::native::cos(kth);
-        double tsin = -kfr::native::sin(kth);
-        return make_vector(static_cast<T>(tcos), static_cast<T>(tsin));
+        const twiddle_octant<T, cpu> octant(period);
+        const size_t stride = periodic ? 1 : step;
+        size_t i            = 0;
+        KFR_LOOP_NOUNROLL
+        for (; i + width <= count; i += width)
+            cwrite<width>(out + i, octant.template get<width>(i * stride, stride));
+        KFR_LOOP_NOUNROLL
+        for (; i < count; i++)
+            cwrite<1>(out + i, octant.template get<1>(i * stride, 0));
+        return;
     }
+    size_t i = 0;
+    KFR_LOOP_NOUNROLL
+    for (; i + width <= count; i += width)
+        cwrite<width>(out + i, calculate_twiddles<T, width>(i * step, step, size));
+    KFR_LOOP_NOUNROLL
+    for (; i < count; i++)
+        cwrite<1>(out + i, calculate_twiddles<T, 1>(i * step, 0, size));
+}
+
+// fill_twiddles for the instruction set selected by cpu (see call_for_cpu)
+template <typename T>
+KFR_NOINLINE void fill_twiddles(complex<T>* out, size_t count, size_t step, size_t size, cpu_t cpu)
+{
+    call_for_cpu(cpu, [&](auto c)
+                          KFR_INLINE_LAMBDA { fill_twiddles<T, val_of(c)>(out, count, step, size); });
 }
 
 template <typename T, size_t width>
-KFR_INTRIN void initialize_twiddles_impl(complex<T>*& twiddle, size_t nn, size_t nnstep, size_t size,
+KFR_INTRIN void initialize_twiddles_impl(complex<T>*& twiddle, const cvec<T, width>& result,
                                          bool split_format)
 {
-    vec<T, 2 * width> result = T();
-    KFR_LOOP_UNROLL
-    for (size_t i = 0; i < width; i++)
-    {
-        const cvec<T, 1> r = calculate_twiddle<T>(nn + nnstep * i, size);
-        result(i * 2)     = r[0];
-        result(i * 2 + 1) = r[1];
-    }
     if (split_format)
         ref_cast<cvec<T, width>>(twiddle[0]) = splitpairs(result);
     else
@@ -240,16 +484,87 @@ KFR_INTRIN void initialize_twiddles_impl(complex<T>*& twiddle, size_t nn, size_t
     twiddle += width;
 }
 
-template <typename T, size_t width>
-KFR_NOINLINE void initialize_twiddles(complex<T>*& twiddle, size_t stage_size, size_t size, bool split_format)
+// Stages with at least this many radix-4 butterflies fill their twiddles on all cores
+constexpr size_t parallel_twiddles_threshold = 65536;
+
+// True if a stage of stage_size fills its twiddles in parallel when given a thread_pool
+inline bool parallel_twiddles(size_t stage_size)
+{
+    return stage_size / 4 >= parallel_twiddles_threshold && thread_pool::default_concurrency() > 1;
+}
+
+// The twiddles exp(-2pi*i*n*m*(size/stage_size)/size) of a radix-4 stage equal exp(-2pi*i*n*m/stage_size),
+// so they are looked up in the octant of stage_size. pool may be null
+template <typename T, cpu_t cpu>
+KFR_NOINLINE void initialize_twiddles(complex<T>*& twiddle, size_t stage_size, size_t size, bool split_format,
+                                      thread_pool* pool = nullptr)
+{
+    constexpr size_t width = vector_width<T, cpu>;
+    const size_t count     = align_up(stage_size / 4, width);
+    // twiddles is inlined into a function compiled for cpu
+    auto fill = [=](complex<T>* tw, size_t begin, size_t end, const auto& twiddles) {
+        cpu_caller<cpu>::call([&]() KFR_INLINE_LAMBDA {
+            KFR_LOOP_NOUNROLL
+            for (size_t n = begin; n < end; n += width)
+            {
+                initialize_twiddles_impl<T, width>(tw, twiddles(n * 1, 1), split_format);
+                initialize_twiddles_impl<T, width>(tw, twiddles(n * 2, 2), split_format);
+                initialize_twiddles_impl<T, width>(tw, twiddles(n * 3, 3), split_format);
+            }
+        });
+    };
+    if (stage_size % 8 != 0)
+    {
+        const size_t nnstep = size / stage_size;
+        fill(twiddle, 0, count, [=](size_t n, size_t step) KFR_INLINE_LAMBDA {
+            return calculate_twiddles<T, width>(n * nnstep, step * nnstep, size);
+        });
+        twiddle += count * 3;
+        return;
+    }
+    const twiddle_octant<T, cpu> octant(stage_size);
+    auto twiddles = [&](size_t n, size_t step)
+                        KFR_INLINE_LAMBDA { return octant.template get<width>(n, step); };
+    if (pool && count >= parallel_twiddles_threshold)
+    {
+        const size_t chunk   = std::max(align_up(count / (pool->size() * 4), width), width);
+        complex<T>* const tw = twiddle;
+        pool->parallel_for((count + chunk - 1) / chunk, [&](size_t index, size_t) {
+            const size_t begin = index * chunk;
+            fill(tw + begin * 3, begin, std::min(begin + chunk, count), twiddles);
+        });
+    }
+    else
+    {
+        fill(twiddle, 0, count, twiddles);
+    }
+    twiddle += count * 3;
+}
+
+template <typename T>
+KFR_NOINLINE void initialize_twiddles_mixed(complex<T>* twiddle, size_t width, size_t iterations,
+                                            size_t radix)
 {
-    size_t nnstep = size / stage_size;
+    // Layout matches butterfly_cycle: groups of width * (radix - 1) twiddles, width halving at the tail
+    const size_t size = iterations * radix;
+    size_t i          = 0;
     KFR_LOOP_NOUNROLL
-    for (size_t n = 0; n < stage_size / 4; n += width)
+    for (; width > 0; width /= 2)
     {
-        initialize_twiddles_impl<T, width>(twiddle, n * nnstep * 1, nnstep * 1, size, split_format);
-        initialize_twiddles_impl<T, width>(twiddle, n * nnstep * 2, nnstep * 2, size, split_format);
-        initialize_twiddles_impl<T, width>(twiddle, n * nnstep * 3, nnstep * 3, size, split_format);
+        KFR_LOOP_NOUNROLL
+        for (; i < iterations / width * width; i += width)
+        {
+            KFR_LOOP_NOUNROLL
+            for (size_t j = 1; j < radix; j++)
+            {
+                KFR_LOOP_NOUNROLL
+                for (size_t k = 0; k < width; k++)
+                {
+                    ref_cast<cvec<T, 1>>(twiddle[0]) = calculate_twiddle<T>((i + k) * j, size);
+                    twiddle++;
+                }
+            }
+        }
     }
 }
 
@@ -414,8 +729,57 @@ KFR_SINTRIN ctrue_t radix4_pass(csize_t<4>, size_t blocks, csize_t<width>, cfals
     return {};
 }
 
-template <typename T, bool splitin, bool is_even, bool inverse>
-struct fft_stage_impl : dft_stage<T>
+// True if the block of block_size elements at offset holds any of the requested bins. The result of the
+// radix-4 stages is digit-reversed, so a block holds the bins congruent to its reversed index modulo the
+// number of blocks
+template <bool use_br2>
+KFR_INTRIN bool fft_block_needed(size_t offset, size_t block_size, size_t size, const dft_pruning& pruning,
+                                 cbool_t<use_br2>)
+{
+    const size_t blocks = size / block_size;
+    if (blocks == 1)
+        return true;
+    const size_t residue = fft_reverse_index(offset / block_size, ilog2(blocks), cbool<use_br2>);
+    const size_t first   = pruning.output_begin + (residue + blocks - pruning.output_begin % blocks) % blocks;
+    return first < pruning.output_end;
+}
+
+// Forward radix4_pass with split output of a block whose input is zero from nonzero < N / 4 on.
+// Three of the four butterfly inputs are zero, so the butterflies reduce to twiddle multiplications of the
+// first quarter, and every quarter of the output is zero from nonzero on
+template <size_t width, bool splitin, bool use_br2, typename T>
+KFR_INTRIN void radix4_pruned_pass(size_t N, size_t nonzero, csize_t<width>, cbool_t<splitin>,
+                                   cbool_t<use_br2>, complex<T>* out, const complex<T>* in,
+                                   const complex<T>* twiddle)
+{
+    const size_t N4   = N / 4;
+    const size_t used = align_up(nonzero, width);
+    KFR_LOOP_NOUNROLL
+    for (size_t n2 = 0; n2 < used; n2 += width)
+    {
+        vec<T, width> re, im;
+        split(cread_split<width, false, !splitin>(in + n2), re, im);
+        const cvec<T, width> a = concat(re, im);
+        const complex<T>* tw   = twiddle + n2 * 3;
+        cwrite_split<width, false, false>(out + n2, a);
+        cwrite_split<width, false, false>(
+            out + n2 + N4 * (use_br2 ? 2 : 1),
+            radix4_apply_twiddle(csize<width>, ctrue, cfalse, a, cread<width, true>(tw)));
+        cwrite_split<width, false, false>(
+            out + n2 + N4 * (use_br2 ? 1 : 2),
+            radix4_apply_twiddle(csize<width>, ctrue, cfalse, a, cread<width, true>(tw + width)));
+        cwrite_split<width, false, false>(
+            out + n2 + N4 * 3,
+            radix4_apply_twiddle(csize<width>, ctrue, cfalse, a, cread<width, true>(tw + width * 2)));
+    }
+    // In place, the zeros are already there
+    if (in != out)
+        for (size_t q = 0; q < 4; q++)
+            std::fill(out + q * N4 + used, out + (q + 1) * N4, complex<T>());
+}
+
+template <typename T, cpu_t cpu, bool splitin, bool is_even, bool prefetch, bool inverse>
+struct fft_stage_impl : dft_stage_cpu<T, cpu, fft_stage_impl<T, cpu, splitin, is_even, prefetch, inverse>>
 {
     fft_stage_impl(size_t stage_size)
     {
@@ -423,34 +787,38 @@ struct fft_stage_impl : dft_stage<T>
         this->repeats    = 4;
         this->recursion  = true;
         this->data_size  = align_up(sizeof(complex<T>) * stage_size / 4 * 3, native_cache_alignment);
+        this->data_name  = dft_data_name<T>("radix4 split", width);
     }
 
 protected:
-    constexpr static bool prefetch = true;
-    constexpr static bool aligned  = false;
-    constexpr static size_t width  = vector_width<T, cpu_t::native>;
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned = false;
+    constexpr static size_t width = vector_width<T, cpu>;
 
     virtual void do_initialize(size_t size) override final
     {
         complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
-        initialize_twiddles<T, width>(twiddle, this->stage_size, size, true);
+        initialize_twiddles<T, cpu>(twiddle, this->stage_size, size, true, this->pool);
     }
 
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* /*temp*/) override final
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* /*temp*/)
     {
         const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
         if (splitin)
             in                  = out;
         const size_t stage_size = this->stage_size;
-        __builtin_assume(stage_size >= 2048);
-        __builtin_assume(stage_size % 2048 == 0);
+        // The smallest stage before a 128-point final stage
+        __builtin_assume(stage_size >= 512);
+        __builtin_assume(stage_size % 512 == 0);
         radix4_pass(stage_size, 1, csize<width>, ctrue, cbool<splitin>, cbool<!is_even>, cbool<prefetch>,
                     cbool<inverse>, cbool<aligned>, out, in, twiddle);
     }
 };
 
-template <typename T, bool splitin, size_t size, bool inverse>
-struct fft_final_stage_impl : dft_stage<T>
+template <typename T, cpu_t cpu, bool splitin, size_t size, bool inverse>
+struct fft_final_stage_impl : dft_stage_cpu<T, cpu, fft_final_stage_impl<T, cpu, splitin, size, inverse>>
 {
     fft_final_stage_impl(size_t)
     {
@@ -459,10 +827,14 @@ struct fft_final_stage_impl : dft_stage<T>
         this->repeats    = 4;
         this->recursion  = true;
         this->data_size  = align_up(sizeof(complex<T>) * size * 3 / 2, native_cache_alignment);
+        this->data_name  = dft_data_name<T>("radix4 final split", width);
     }
 
 protected:
-    constexpr static size_t width  = vector_width<T, cpu_t::native>;
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static size_t width  = vector_width<T, cpu>;
     constexpr static bool is_even  = cometa::is_even(ilog2(size));
     constexpr static bool use_br2  = !is_even;
     constexpr static bool aligned  = false;
@@ -474,70 +846,45 @@ protected:
         size_t stage_size   = this->stage_size;
         while (stage_size > 4)
         {
-            initialize_twiddles<T, width>(twiddle, stage_size, total_size, true);
+            initialize_twiddles<T, cpu>(twiddle, stage_size, total_size, true);
             stage_size /= 4;
         }
     }
 
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* /*temp*/) override final
-    {
-        constexpr bool is_double    = sizeof(T) == 8;
-        constexpr size_t final_size = is_even ? (is_double ? 4 : 16) : (is_double ? 8 : 32);
-        const complex<T>* twiddle   = ptr_cast<complex<T>>(this->data);
-        final_pass(csize<final_size>, out, in, twiddle);
-    }
-
-    KFR_INTRIN void final_pass(csize_t<8>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* /*temp*/)
     {
-        radix4_pass(csize<512>, 1, csize<width>, ctrue, cbool<splitin>, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
-        radix4_pass(csize<128>, 4, csize<width>, ctrue, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<32>, 16, csize<width>, cfalse, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<8>, 64, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
+        // Generic passes need at least width butterflies, so wide vectors end with 16 or 32-point passes
+        constexpr bool narrow     = sizeof(T) == 8 && width <= 4;
+        constexpr size_t last     = is_even ? (narrow ? 4 : 16) : (narrow ? 8 : 32);
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        final_pass(csize<size>, csize<last>, cbool<splitin>, out, in, twiddle);
     }
 
-    KFR_INTRIN void final_pass(csize_t<32>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    // Radix-4 passes of N points down to last. Data stays in the split format up to the pass before last
+    template <size_t N, size_t last, bool splitin_pass>
+    KFR_INTRIN void final_pass(csize_t<N>, csize_t<last>, cbool_t<splitin_pass>, complex<T>* out,
+                               const complex<T>* in, const complex<T>*& twiddle)
     {
-        radix4_pass(csize<512>, 1, csize<width>, ctrue, cbool<splitin>, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
-        radix4_pass(csize<128>, 4, csize<width>, cfalse, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<32>, 16, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
+        constexpr bool splitout = N > last * 4;
+        radix4_pass(csize<N>, size / N, csize<width>, cbool<splitout>, cbool<splitin_pass>, cbool<use_br2>,
+                    cbool<prefetch>, cbool<inverse>, cbool<aligned>, out, in, twiddle);
+        next_pass(cbool<(N > last)>, csize<N / 4>, csize<last>, cbool<splitout>, out, twiddle);
     }
-
-    KFR_INTRIN void final_pass(csize_t<4>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    template <size_t N, size_t last, bool splitin_pass>
+    KFR_INTRIN void next_pass(ctrue_t, csize_t<N>, csize_t<last>, cbool_t<splitin_pass>, complex<T>* out,
+                               const complex<T>*& twiddle)
     {
-        radix4_pass(csize<1024>, 1, csize<width>, ctrue, cbool<splitin>, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
-        radix4_pass(csize<256>, 4, csize<width>, ctrue, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<64>, 16, csize<width>, ctrue, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<16>, 64, csize<width>, cfalse, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<4>, 256, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
+        final_pass(csize<N>, csize<last>, cbool<splitin_pass>, out, out, twiddle);
     }
-
-    KFR_INTRIN void final_pass(csize_t<16>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    template <size_t N, size_t last, bool splitin_pass>
+    KFR_INTRIN void next_pass(cfalse_t, csize_t<N>, csize_t<last>, cbool_t<splitin_pass>, complex<T>*,
+                               const complex<T>*&)
     {
-        radix4_pass(csize<1024>, 1, csize<width>, ctrue, cbool<splitin>, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
-        radix4_pass(csize<256>, 4, csize<width>, ctrue, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<64>, 16, csize<width>, cfalse, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<16>, 64, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
     }
 };
 
-template <typename T, bool is_even>
-struct fft_reorder_stage_impl : dft_stage<T>
+template <typename T, cpu_t cpu, bool is_even>
+struct fft_reorder_stage_impl : dft_stage_cpu<T, cpu, fft_reorder_stage_impl<T, cpu, is_even>>
 {
     fft_reorder_stage_impl(size_t stage_size)
     {
@@ -547,160 +894,483 @@ struct fft_reorder_stage_impl : dft_stage<T>
     }
 
 protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
     size_t log2n;
 
     virtual void do_initialize(size_t) override final {}
 
-    virtual void do_execute(complex<T>* out, const complex<T>*, u8* /*temp*/) override final
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>*, u8* /*temp*/)
     {
         fft_reorder(out, log2n, cbool<!is_even>);
     }
 };
 
-template <typename T, size_t log2n, bool inverse>
-struct fft_specialization;
-
-template <typename T, bool inverse>
-struct fft_specialization<T, 1, inverse> : dft_stage<T>
-{
-    fft_specialization(size_t) {}
-protected:
-    constexpr static bool aligned = false;
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8*) override final
-    {
-        cvec<T, 1> a0, a1;
-        split(cread<2, aligned>(in), a0, a1);
-        cwrite<2, aligned>(out, concat(a0 + a1, a0 - a1));
-    }
-};
-
-template <typename T, bool inverse>
-struct fft_specialization<T, 2, inverse> : dft_stage<T>
+// fft_stage_impl of a pruned plan. Blocks that hold none of the requested bins are skipped, and while the
+// nonzero part of the input is shorter than a quarter of the block, only that part is transformed
+template <typename T, cpu_t cpu, bool splitin, bool is_even, bool prefetch>
+struct fft_pruned_stage_impl
+    : dft_pruned_stage_cpu<T, cpu, fft_pruned_stage_impl<T, cpu, splitin, is_even, prefetch>>
 {
-    fft_specialization(size_t) {}
-protected:
-    constexpr static bool aligned = false;
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8*) override final
+    fft_pruned_stage_impl(size_t stage_size, size_t size, const dft_pruning& pruning)
+        : size(size), pruning(pruning)
     {
-        cvec<T, 1> a0, a1, a2, a3;
-        split(cread<4>(in), a0, a1, a2, a3);
-        butterfly(cbool<inverse>, a0, a1, a2, a3, a0, a1, a2, a3);
-        cwrite<4>(out, concat(a0, a1, a2, a3));
+        this->stage_size = stage_size;
+        this->repeats    = 4;
+        this->recursion  = true;
+        this->data_size  = align_up(sizeof(complex<T>) * stage_size / 4 * 3, native_cache_alignment);
+        this->data_name  = dft_data_name<T>("radix4 split", width);
     }
-};
 
-template <typename T, bool inverse>
-struct fft_specialization<T, 3, inverse> : dft_stage<T>
-{
-    fft_specialization(size_t) {}
 protected:
-    constexpr static bool aligned = false;
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8*) override final
-    {
-        cvec<T, 8> v8 = cread<8, aligned>(in);
-        butterfly8<inverse>(v8);
-        cwrite<8, aligned>(out, v8);
-    }
-};
+    template <typename, cpu_t, typename>
+    friend struct dft_pruned_stage_cpu;
 
-template <typename T, bool inverse>
-struct fft_specialization<T, 4, inverse> : dft_stage<T>
-{
-    fft_specialization(size_t) {}
-protected:
     constexpr static bool aligned = false;
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8*) override final
-    {
-        cvec<T, 16> v16 = cread<16, aligned>(in);
-        butterfly16<inverse>(v16);
-        cwrite<16, aligned>(out, v16);
-    }
-};
+    constexpr static size_t width = vector_width<T, cpu>;
+    size_t size;
+    dft_pruning pruning;
 
-template <typename T, bool inverse>
-struct fft_specialization<T, 5, inverse> : dft_stage<T>
-{
-    fft_specialization(size_t) {}
-protected:
-    constexpr static bool aligned = false;
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8*) override final
+    virtual void do_initialize(size_t size) override final
     {
-        cvec<T, 32> v32 = cread<32, aligned>(in);
-        butterfly32<inverse>(v32);
-        cwrite<32, aligned>(out, v32);
+        complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        initialize_twiddles<T, cpu>(twiddle, this->stage_size, size, true, this->pool);
     }
-};
 
-template <typename T, bool inverse>
-struct fft_specialization<T, 6, inverse> : dft_stage<T>
-{
-    fft_specialization(size_t) {}
-protected:
-    constexpr static bool aligned = false;
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8*) override final
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* /*temp*/, size_t offset)
     {
-        butterfly64(cbool<inverse>, cbool<aligned>, out, in);
+        const size_t stage_size = this->stage_size;
+        if (!fft_block_needed(offset, stage_size, size, pruning, cbool<!is_even>))
+            return;
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        if (splitin)
+            in = out;
+        if (pruning.input_size < stage_size / 4)
+            radix4_pruned_pass(stage_size, pruning.input_size, csize<width>, cbool<splitin>, cbool<!is_even>,
+                               out, in, twiddle);
+        else
+            radix4_pass(stage_size, 1, csize<width>, ctrue, cbool<splitin>, cbool<!is_even>, cbool<prefetch>,
+                        cfalse, cbool<aligned>, out, in, twiddle);
     }
 };
 
-template <typename T, bool inverse>
-struct fft_specialization<T, 7, inverse> : dft_stage<T>
+// fft_final_stage_impl of a pruned plan. Every pass skips the blocks that hold none of the requested bins,
+// the last pass, which handles several blocks at once, is skipped per block of the previous pass
+template <typename T, cpu_t cpu, bool splitin, size_t size>
+struct fft_pruned_final_stage_impl
+    : dft_pruned_stage_cpu<T, cpu, fft_pruned_final_stage_impl<T, cpu, splitin, size>>
 {
-    fft_specialization(size_t)
+    fft_pruned_final_stage_impl(size_t, size_t total_size, const dft_pruning& pruning)
+        : total_size(total_size), pruning(pruning)
     {
-        this->stage_size = 128;
-        this->data_size  = align_up(sizeof(complex<T>) * 128 * 3 / 2, native_cache_alignment);
+        this->stage_size = size;
+        this->out_offset = size;
+        this->repeats    = 4;
+        this->recursion  = true;
+        this->data_size  = align_up(sizeof(complex<T>) * size * 3 / 2, native_cache_alignment);
+        this->data_name  = dft_data_name<T>("radix4 final split", width);
     }
 
 protected:
-    constexpr static bool aligned        = false;
-    constexpr static size_t width        = vector_width<T, cpu_t::native>;
-    constexpr static bool use_br2        = true;
-    constexpr static bool prefetch       = false;
-    constexpr static bool is_double      = sizeof(T) == 8;
-    constexpr static size_t final_size   = is_double ? 8 : 32;
-    constexpr static size_t split_format = final_size == 8;
+    template <typename, cpu_t, typename>
+    friend struct dft_pruned_stage_cpu;
+
+    constexpr static size_t width  = vector_width<T, cpu>;
+    constexpr static bool is_even  = cometa::is_even(ilog2(size));
+    constexpr static bool use_br2  = !is_even;
+    constexpr static bool aligned  = false;
+    constexpr static bool prefetch = splitin;
+    size_t total_size;
+    dft_pruning pruning;
 
     virtual void do_initialize(size_t total_size) override final
     {
         complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
-        initialize_twiddles<T, width>(twiddle, 128, total_size, split_format);
-        initialize_twiddles<T, width>(twiddle, 32, total_size, split_format);
-        initialize_twiddles<T, width>(twiddle, 8, total_size, split_format);
+        size_t stage_size   = this->stage_size;
+        while (stage_size > 4)
+        {
+            initialize_twiddles<T, cpu>(twiddle, stage_size, total_size, true);
+            stage_size /= 4;
+        }
     }
 
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* /*temp*/) override final
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* /*temp*/, size_t offset)
     {
+        constexpr bool narrow = sizeof(T) == 8 && width <= 4;
+        constexpr size_t last = is_even ? (narrow ? 4 : 16) : (narrow ? 8 : 32);
+        if (!fft_block_needed(offset, size, total_size, pruning, cbool<use_br2>))
+            return;
         const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
-        final_pass(csize<final_size>, out, in, twiddle);
-        fft_reorder(out, csize<7>);
+        final_pass(csize<size>, csize<last>, cbool<splitin>, out, in, offset, twiddle);
     }
 
-    KFR_INTRIN void final_pass(csize_t<8>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    // radix4_pass on every needed group of blocks of N elements
+    template <size_t N, bool splitout, bool splitin_pass, size_t group>
+    KFR_INTRIN void pruned_pass(csize_t<N>, cbool_t<splitout>, cbool_t<splitin_pass>, csize_t<group>,
+                                complex<T>* out, const complex<T>* in, size_t offset,
+                                const complex<T>*& twiddle)
     {
-        radix4_pass(csize<128>, 1, csize<width>, ctrue, cfalse, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
-        radix4_pass(csize<32>, 4, csize<width>, cfalse, ctrue, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
-        radix4_pass(csize<8>, 16, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
+        for (size_t b = 0; b < size; b += N * group)
+        {
+            if (!fft_block_needed(offset + b, N * group, total_size, pruning, cbool<use_br2>))
+                continue;
+            const complex<T>* block_twiddle = twiddle;
+            radix4_pass(csize<N>, group, csize<width>, cbool<splitout>, cbool<splitin_pass>, cbool<use_br2>,
+                        cbool<prefetch>, cfalse, cbool<aligned>, out + b, in + b, block_twiddle);
+        }
+        twiddle += N / 4 * 3;
     }
 
-    KFR_INTRIN void final_pass(csize_t<32>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    // The passes of fft_final_stage_impl, the last one in groups of 4 blocks
+    template <size_t N, size_t last, bool splitin_pass>
+    KFR_INTRIN void final_pass(csize_t<N>, csize_t<last>, cbool_t<splitin_pass>, complex<T>* out,
+                               const complex<T>* in, size_t offset, const complex<T>*& twiddle)
     {
-        radix4_pass(csize<128>, 1, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
-                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
-        radix4_pass(csize<32>, 4, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
+        constexpr bool splitout = N > last * 4;
+        pruned_pass(csize<N>, cbool<splitout>, cbool<splitin_pass>, csize<(N > last ? 1 : 4)>, out, in,
+                    offset, twiddle);
+        next_pass(cbool<(N > last)>, csize<N / 4>, csize<last>, cbool<splitout>, out, offset, twiddle);
+    }
+    template <size_t N, size_t last, bool splitin_pass>
+    KFR_INTRIN void next_pass(ctrue_t, csize_t<N>, csize_t<last>, cbool_t<splitin_pass>, complex<T>* out,
+                               size_t offset, const complex<T>*& twiddle)
+    {
+        final_pass(csize<N>, csize<last>, cbool<splitin_pass>, out, out, offset, twiddle);
+    }
+    template <size_t N, size_t last, bool splitin_pass>
+    KFR_INTRIN void next_pass(cfalse_t, csize_t<N>, csize_t<last>, cbool_t<splitin_pass>, complex<T>*,
+                               size_t, const complex<T>*&)
+    {
+    }
+};
+
+// fft_reorder_stage_impl of a pruned plan, moves only the requested bins to their places
+template <typename T, cpu_t cpu, bool is_even>
+struct fft_pruned_reorder_stage_impl : dft_stage_cpu<T, cpu, fft_pruned_reorder_stage_impl<T, cpu, is_even>>
+{
+    fft_pruned_reorder_stage_impl(size_t stage_size, size_t, const dft_pruning& pruning) : pruning(pruning)
+    {
+        this->stage_size = stage_size;
+        this->data_size  = 0;
+    }
+
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    dft_pruning pruning;
+
+    virtual void do_initialize(size_t) override final {}
+
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>*, u8* /*temp*/)
+    {
+        const size_t log2n = ilog2(this->stage_size);
+        const size_t begin = pruning.output_begin;
+        const size_t end   = pruning.output_end;
+        // Bin k is at reverse(k). If that position is outside the range, its own bin is not needed
+        for (size_t k = begin; k < end; k++)
+        {
+            const size_t j = fft_reverse_index(k, log2n, cbool<!is_even>);
+            if (j < begin || j >= end)
+                out[k] = out[j];
+            else if (k < j)
+                std::swap(out[k], out[j]);
+        }
+    }
+};
+
+// Undoes one fft_stage_impl pass for the inverse of scrambled plans: conjugated twiddles, then the inverse
+// butterfly. Data is interleaved and all blocks of the stage are processed in one call
+template <typename T, cpu_t cpu, bool use_br2>
+struct fft_dit_stage_impl : dft_stage_cpu<T, cpu, fft_dit_stage_impl<T, cpu, use_br2>>
+{
+    fft_dit_stage_impl(size_t stage_size, size_t blocks) : blocks(blocks)
+    {
+        this->stage_size = stage_size;
+        this->data_size  = align_up(sizeof(complex<T>) * stage_size / 4 * 3, native_cache_alignment);
+        this->data_name  = dft_data_name<T>("radix4 interleaved", width);
+    }
+
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static size_t width = vector_width<T, cpu>;
+    size_t blocks;
+
+    virtual void do_initialize(size_t) override final
+    {
+        complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        initialize_twiddles<T, cpu>(twiddle, this->stage_size, this->stage_size, false);
+    }
+
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* /*temp*/)
+    {
+        const size_t stage_size = this->stage_size;
+        const size_t N4         = stage_size / 4;
+        KFR_LOOP_NOUNROLL
+        for (size_t b = 0; b < blocks; b++)
+        {
+            const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+            KFR_LOOP_NOUNROLL
+            for (size_t i = 0; i < N4; i += width)
+            {
+                // The forward pass stores outputs 1 and 2 swapped when use_br2 is set
+                const cvec<T, width> y0 = cread<width>(in + i);
+                const cvec<T, width> y1 =
+                    cmul_conj(cread<width>(in + i + N4 * (use_br2 ? 2 : 1)), cread<width, true>(twiddle));
+                const cvec<T, width> y2 = cmul_conj(cread<width>(in + i + N4 * (use_br2 ? 1 : 2)),
+                                                    cread<width, true>(twiddle + width));
+                const cvec<T, width> y3 =
+                    cmul_conj(cread<width>(in + i + N4 * 3), cread<width, true>(twiddle + width * 2));
+                twiddle += width * 3;
+
+                const cvec<T, width> sum02  = y0 + y2;
+                const cvec<T, width> diff02 = y0 - y2;
+                const cvec<T, width> sum13  = y1 + y3;
+                const cvec<T, width> diff13 = negeven(swap<2>(y1 - y3)); // i * (y1 - y3)
+                cwrite<width>(out + i, sum02 + sum13);
+                cwrite<width>(out + i + N4, diff02 + diff13);
+                cwrite<width>(out + i + N4 * 2, sum02 - sum13);
+                cwrite<width>(out + i + N4 * 3, diff02 - diff13);
+            }
+            in += stage_size;
+            out += stage_size;
+        }
+    }
+};
+
+// Undoes the fft_final_stage_impl blocks for the inverse of scrambled plans.
+// Each block is reordered and transformed by a natural order inverse plan while it is in cache
+template <typename T, cpu_t cpu, bool use_br2>
+struct fft_final_inverse_stage_impl : dft_stage_cpu<T, cpu, fft_final_inverse_stage_impl<T, cpu, use_br2>>
+{
+    fft_final_inverse_stage_impl(size_t stage_size, size_t blocks,
+                                 const std::shared_ptr<const dft_plan<T>>& plan)
+        : blocks(blocks), plan(plan)
+    {
+        this->stage_size = stage_size;
+        this->temp_size  = plan->temp_size;
+    }
+
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    size_t blocks;
+    std::shared_ptr<const dft_plan<T>> plan;
+
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* temp)
+    {
+        const size_t stage_size = this->stage_size;
+        const size_t log2n      = ilog2(stage_size);
+        KFR_LOOP_NOUNROLL
+        for (size_t b = 0; b < blocks; b++)
+        {
+            if (in != out)
+                std::copy(in, in + stage_size, out);
+            fft_reorder(out, log2n, cbool<use_br2>);
+            plan->execute(out, out, temp, ctrue);
+            in += stage_size;
+            out += stage_size;
+        }
+    }
+};
+
+template <typename T, cpu_t cpu, size_t log2n, bool inverse>
+struct fft_specialization;
+
+template <typename T, cpu_t cpu, bool inverse>
+struct fft_specialization<T, cpu, 0, inverse>
+    : dft_stage_cpu<T, cpu, fft_specialization<T, cpu, 0, inverse>>
+{
+    fft_specialization(size_t) {}
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned = false;
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8*)
+    {
+        cwrite<1, aligned>(out, cread<1, aligned>(in));
+    }
+};
+
+template <typename T, cpu_t cpu, bool inverse>
+struct fft_specialization<T, cpu, 1, inverse>
+    : dft_stage_cpu<T, cpu, fft_specialization<T, cpu, 1, inverse>>
+{
+    fft_specialization(size_t) {}
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned = false;
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8*)
+    {
+        cvec<T, 1> a0, a1;
+        split(cread<2, aligned>(in), a0, a1);
+        cwrite<2, aligned>(out, concat(a0 + a1, a0 - a1));
+    }
+};
+
+template <typename T, cpu_t cpu, bool inverse>
+struct fft_specialization<T, cpu, 2, inverse>
+    : dft_stage_cpu<T, cpu, fft_specialization<T, cpu, 2, inverse>>
+{
+    fft_specialization(size_t) {}
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned = false;
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8*)
+    {
+        cvec<T, 1> a0, a1, a2, a3;
+        split(cread<4>(in), a0, a1, a2, a3);
+        butterfly(cbool<inverse>, a0, a1, a2, a3, a0, a1, a2, a3);
+        cwrite<4>(out, concat(a0, a1, a2, a3));
+    }
+};
+
+template <typename T, cpu_t cpu, bool inverse>
+struct fft_specialization<T, cpu, 3, inverse>
+    : dft_stage_cpu<T, cpu, fft_specialization<T, cpu, 3, inverse>>
+{
+    fft_specialization(size_t) {}
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned = false;
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8*)
+    {
+        cvec<T, 8> v8 = cread<8, aligned>(in);
+        butterfly8<inverse>(v8);
+        cwrite<8, aligned>(out, v8);
+    }
+};
+
+template <typename T, cpu_t cpu, bool inverse>
+struct fft_specialization<T, cpu, 4, inverse>
+    : dft_stage_cpu<T, cpu, fft_specialization<T, cpu, 4, inverse>>
+{
+    fft_specialization(size_t) {}
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned = false;
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8*)
+    {
+        cvec<T, 16> v16 = cread<16, aligned>(in);
+        butterfly16<inverse>(v16);
+        cwrite<16, aligned>(out, v16);
+    }
+};
+
+template <typename T, cpu_t cpu, bool inverse>
+struct fft_specialization<T, cpu, 5, inverse>
+    : dft_stage_cpu<T, cpu, fft_specialization<T, cpu, 5, inverse>>
+{
+    fft_specialization(size_t) {}
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned = false;
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8*)
+    {
+        cvec<T, 32> v32 = cread<32, aligned>(in);
+        butterfly32<inverse>(v32);
+        cwrite<32, aligned>(out, v32);
+    }
+};
+
+template <typename T, cpu_t cpu, bool inverse>
+struct fft_specialization<T, cpu, 6, inverse>
+    : dft_stage_cpu<T, cpu, fft_specialization<T, cpu, 6, inverse>>
+{
+    fft_specialization(size_t) {}
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned = false;
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8*)
+    {
+        butterfly64(cbool<inverse>, cbool<aligned>, out, in);
+    }
+};
+
+template <typename T, cpu_t cpu, bool inverse>
+struct fft_specialization<T, cpu, 7, inverse>
+    : dft_stage_cpu<T, cpu, fft_specialization<T, cpu, 7, inverse>>
+{
+    fft_specialization(size_t)
+    {
+        this->stage_size = 128;
+        this->data_size  = align_up(sizeof(complex<T>) * 128 * 3 / 2, native_cache_alignment);
+        this->data_name  = dft_data_name<T>("fft128", width);
+    }
+
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static bool aligned        = false;
+    constexpr static size_t width        = vector_width<T, cpu>;
+    constexpr static bool use_br2        = true;
+    constexpr static bool prefetch       = false;
+    constexpr static bool is_double      = sizeof(T) == 8;
+    constexpr static size_t final_size   = is_double ? 8 : 32;
+    constexpr static size_t split_format = final_size == 8;
+
+    virtual void do_initialize(size_t total_size) override final
+    {
+        complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        initialize_twiddles<T, cpu>(twiddle, 128, total_size, split_format);
+        initialize_twiddles<T, cpu>(twiddle, 32, total_size, split_format);
+        initialize_twiddles<T, cpu>(twiddle, 8, total_size, split_format);
+    }
+
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* /*temp*/)
+    {
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        final_pass(csize<final_size>, out, in, twiddle);
+        fft_reorder(out, csize<7>);
+    }
+
+    KFR_INTRIN void final_pass(csize_t<8>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    {
+        radix4_pass(csize<128>, 1, csize<width>, ctrue, cfalse, cbool<use_br2>, cbool<prefetch>,
+                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
+        radix4_pass(csize<32>, 4, csize<width>, cfalse, ctrue, cbool<use_br2>, cbool<prefetch>,
+                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
+        radix4_pass(csize<8>, 16, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
+                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
+    }
+
+    KFR_INTRIN void final_pass(csize_t<32>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    {
+        radix4_pass(csize<128>, 1, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
+                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
+        radix4_pass(csize<32>, 4, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
                     cbool<inverse>, cbool<aligned>, out, out, twiddle);
     }
 };
 
-template <bool inverse>
-struct fft_specialization<float, 8, inverse> : dft_stage<float>
+template <cpu_t cpu, bool inverse>
+struct fft_specialization<float, cpu, 8, inverse>
+    : dft_stage_cpu<float, cpu, fft_specialization<float, cpu, 8, inverse>>
 {
     fft_specialization(size_t) { this->temp_size = sizeof(complex<float>) * 256; }
 protected:
-    virtual void do_execute(complex<float>* out, const complex<float>* in, u8* temp) override final
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    KFR_INTRIN void execute_impl(complex<float>* out, const complex<float>* in, u8* temp)
     {
         complex<float>* scratch = ptr_cast<complex<float>>(temp);
         if (out == in)
@@ -730,19 +1400,24 @@ protected:
     }
 };
 
-template <bool inverse>
-struct fft_specialization<double, 8, inverse> : dft_stage<double>
+template <cpu_t cpu, bool inverse>
+struct fft_specialization<double, cpu, 8, inverse>
+    : dft_stage_cpu<double, cpu, fft_specialization<double, cpu, 8, inverse>>
 {
     using T = double;
     fft_specialization(size_t)
     {
         this->stage_size = 256;
         this->data_size  = align_up(sizeof(complex<T>) * 256 * 3 / 2, native_cache_alignment);
+        this->data_name  = dft_data_name<T>("fft256", width);
     }
 
 protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
     constexpr static bool aligned        = false;
-    constexpr static size_t width        = vector_width<T, cpu_t::native>;
+    constexpr static size_t width        = vector_width<T, cpu>;
     constexpr static bool use_br2        = false;
     constexpr static bool prefetch       = false;
     constexpr static size_t split_format = true;
@@ -750,15 +1425,15 @@ protected:
     virtual void do_initialize(size_t total_size) override final
     {
         complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
-        initialize_twiddles<T, width>(twiddle, 256, total_size, split_format);
-        initialize_twiddles<T, width>(twiddle, 64, total_size, split_format);
-        initialize_twiddles<T, width>(twiddle, 16, total_size, split_format);
+        initialize_twiddles<T, cpu>(twiddle, 256, total_size, split_format);
+        initialize_twiddles<T, cpu>(twiddle, 64, total_size, split_format);
+        initialize_twiddles<T, cpu>(twiddle, 16, total_size, split_format);
     }
 
-    virtual void do_execute(complex<T>* out, const complex<T>* in, u8* /*temp*/) override final
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* /*temp*/)
     {
         const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
-        final_pass(csize<4>, out, in, twiddle);
+        final_pass(csize<(width > 4 ? 16 : 4)>, out, in, twiddle);
         fft_reorder(out, csize<8>);
     }
 
@@ -773,32 +1448,316 @@ protected:
         radix4_pass(csize<4>, 64, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
                     cbool<inverse>, cbool<aligned>, out, out, twiddle);
     }
+
+    KFR_INTRIN void final_pass(csize_t<16>, complex<T>* out, const complex<T>* in, const complex<T>* twiddle)
+    {
+        radix4_pass(csize<256>, 1, csize<width>, ctrue, cfalse, cbool<use_br2>, cbool<prefetch>,
+                    cbool<inverse>, cbool<aligned>, out, in, twiddle);
+        radix4_pass(csize<64>, 4, csize<width>, cfalse, ctrue, cbool<use_br2>, cbool<prefetch>,
+                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
+        radix4_pass(csize<16>, 16, csize<width>, cfalse, cfalse, cbool<use_br2>, cbool<prefetch>,
+                    cbool<inverse>, cbool<aligned>, out, out, twiddle);
+    }
+};
+
+template <typename T, cpu_t cpu, size_t radix, bool inverse>
+struct dft_stage_fixed_impl : dft_stage_cpu<T, cpu, dft_stage_fixed_impl<T, cpu, radix, inverse>>
+{
+    dft_stage_fixed_impl(size_t stage_size, size_t blocks) : blocks(blocks)
+    {
+        this->stage_size = stage_size;
+        this->data_size =
+            align_up(sizeof(complex<T>) * stage_size / radix * (radix - 1), native_cache_alignment);
+        this->data_name = dft_data_name<T>("radix" + std::to_string(radix), width);
+    }
+
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static size_t width = vector_width<T, cpu>;
+    size_t blocks;
+
+    virtual void do_initialize(size_t) override final
+    {
+        complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        initialize_twiddles_mixed(twiddle, width, this->stage_size / radix, radix);
+    }
+
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* /*temp*/)
+    {
+        const complex<T>* twiddle = ptr_cast<complex<T>>(this->data);
+        const size_t stage_size   = this->stage_size;
+        const size_t iterations   = stage_size / radix;
+        KFR_LOOP_NOUNROLL
+        for (size_t b = 0; b < blocks; b++)
+        {
+            butterflies(iterations, csize<width>, csize<radix>, cbool<inverse>, out, in, twiddle, iterations);
+            in += stage_size;
+            out += stage_size;
+        }
+    }
+};
+
+template <typename T, cpu_t cpu, size_t radix, bool inverse>
+struct dft_stage_fixed_final_impl
+    : dft_stage_cpu<T, cpu, dft_stage_fixed_final_impl<T, cpu, radix, inverse>>
+{
+    dft_stage_fixed_final_impl(size_t stage_size, const size_t* radices, size_t count) : count(count)
+    {
+        this->stage_size = stage_size;
+        this->data_size  = align_up(sizeof(u32) * stage_size / radix, native_cache_alignment);
+        this->data_name  = dft_data_name<T>("radix" + std::to_string(radix) + " final", width);
+        // cread_transposed may read up to one vector past the end of the input
+        this->temp_size = sizeof(complex<T>) * (stage_size + width);
+        std::copy(radices, radices + count, this->radices);
+    }
+
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static size_t width = vector_width<T, cpu>;
+    size_t radices[32];
+    size_t count;
+
+    virtual void do_initialize(size_t) override final
+    {
+        // Maps each block to its position in natural order (mixed-radix digit reversal)
+        u32* dest           = ptr_cast<u32>(this->data);
+        const size_t blocks = this->stage_size / radix;
+        for (size_t i = 0; i < blocks; i++)
+        {
+            size_t index  = i;
+            size_t stride = blocks;
+            size_t scale  = 1;
+            size_t result = 0;
+            for (size_t r = 0; r < count; r++)
+            {
+                stride /= radices[r];
+                result += index / stride * scale;
+                index %= stride;
+                scale *= radices[r];
+            }
+            dest[i] = static_cast<u32>(result);
+        }
+    }
+
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* temp)
+    {
+        const u32* dest         = ptr_cast<u32>(this->data);
+        complex<T>* scratch     = ptr_cast<complex<T>>(temp);
+        const size_t stage_size = this->stage_size;
+        const size_t blocks     = stage_size / radix;
+        builtin_memcpy(scratch, in, sizeof(complex<T>) * stage_size);
+        butterflies(blocks, csize<width>, csize<radix>, cbool<inverse>, out, scratch, dest, blocks);
+    }
+};
+
+// out[i] = x[i] * y[i], or x[i] * conj(y[i]) if conj_y. out may be equal to x or y
+template <cpu_t cpu, bool conj_y, typename T>
+KFR_INTRIN void complex_multiply(ccpu_t<cpu>, cbool_t<conj_y>, complex<T>* out, const complex<T>* x,
+                                 const complex<T>* y, size_t size)
+{
+    constexpr size_t width = vector_width<T, cpu>;
+    size_t i               = 0;
+    KFR_LOOP_NOUNROLL
+    for (; i + width <= size; i += width)
+    {
+        const cvec<T, width> a = cread<width>(x + i);
+        const cvec<T, width> b = cread<width>(y + i);
+        cwrite<width>(out + i, conj_y ? cmul_conj(a, b) : cmul(a, b));
+    }
+    KFR_LOOP_NOUNROLL
+    for (; i < size; i++)
+    {
+        const cvec<T, 1> a = cread<1>(x + i);
+        const cvec<T, 1> b = cread<1>(y + i);
+        cwrite<1>(out + i, conj_y ? cmul_conj(a, b) : cmul(a, b));
+    }
+}
+
+template <typename T, cpu_t cpu, bool inverse>
+struct dft_chirpz_stage_impl : dft_stage_cpu<T, cpu, dft_chirpz_stage_impl<T, cpu, inverse>>
+{
+    dft_chirpz_stage_impl(size_t stage_size, const std::shared_ptr<const dft_plan<T>>& plan) : plan(plan)
+    {
+        this->stage_size = stage_size;
+        this->data_size  = align_up(sizeof(complex<T>) * (stage_size + plan->size), native_cache_alignment);
+        this->data_name  = dft_data_name<T>("chirp-z", width);
+        this->temp_size  = sizeof(complex<T>) * plan->size + plan->temp_size;
+    }
+
+protected:
+    template <typename, cpu_t, typename>
+    friend struct dft_stage_cpu;
+
+    constexpr static size_t width = vector_width<T, cpu>;
+    std::shared_ptr<const dft_plan<T>> plan;
+
+    virtual void do_initialize(size_t) override final
+    {
+        const size_t size     = this->stage_size;
+        const size_t fft_size = plan->size;
+        complex<T>* chirp     = ptr_cast<complex<T>>(this->data);
+        complex<T>* spectrum  = chirp + size;
+
+        // chirp[n] = exp(-i * pi * n^2 / size)
+        for (size_t n = 0; n < size; n++)
+            ref_cast<cvec<T, 1>>(chirp[n]) = calculate_twiddle<T>(n * n % (size * 2), size * 2);
+
+        // spectrum = fft(conj(chirp) extended symmetrically to fft_size) / fft_size
+        std::fill(spectrum, spectrum + fft_size, complex<T>(0));
+        for (size_t n = 0; n < size; n++)
+            spectrum[n] = spectrum[(fft_size - n) % fft_size] = complex<T>(chirp[n].real(), -chirp[n].imag());
+        autofree<u8> temp(plan->temp_size);
+        plan->execute(spectrum, spectrum, temp.data(), cfalse);
+        const T scale = T(1) / T(fft_size);
+        for (size_t n = 0; n < fft_size; n++)
+            spectrum[n] = complex<T>(spectrum[n].real() * scale, spectrum[n].imag() * scale);
+    }
+
+    KFR_INTRIN void execute_impl(complex<T>* out, const complex<T>* in, u8* temp)
+    {
+        const size_t size          = this->stage_size;
+        const size_t fft_size      = plan->size;
+        const complex<T>* chirp    = ptr_cast<complex<T>>(this->data);
+        const complex<T>* spectrum = chirp + size;
+        complex<T>* work           = ptr_cast<complex<T>>(temp);
+        u8* plan_temp              = temp + sizeof(complex<T>) * fft_size;
+
+        // The inverse transform is the forward one with all chirps conjugated
+        complex_multiply(ccpu<cpu>, cbool<inverse>, work, in, chirp, size);
+        std::fill(work + size, work + fft_size, complex<T>(0));
+        plan->execute(work, work, plan_temp, cfalse);
+        complex_multiply(ccpu<cpu>, cbool<inverse>, work, work, spectrum, fft_size);
+        plan->execute(work, work, plan_temp, ctrue);
+        complex_multiply(ccpu<cpu>, cbool<inverse>, out, work, chirp, size);
+    }
 };
 
-template <typename T, bool splitin, bool is_even>
+template <typename T, cpu_t cpu, bool splitin, bool is_even, bool prefetch>
 struct fft_stage_impl_t
 {
     template <bool inverse>
-    using type = internal::fft_stage_impl<T, splitin, is_even, inverse>;
+    using type = internal::fft_stage_impl<T, cpu, splitin, is_even, prefetch, inverse>;
 };
-template <typename T, bool splitin, size_t size>
+template <typename T, cpu_t cpu, bool splitin, size_t size>
 struct fft_final_stage_impl_t
 {
     template <bool inverse>
-    using type = internal::fft_final_stage_impl<T, splitin, size, inverse>;
+    using type = internal::fft_final_stage_impl<T, cpu, splitin, size, inverse>;
 };
-template <typename T, bool is_even>
+template <typename T, cpu_t cpu, bool is_even>
 struct fft_reorder_stage_impl_t
 {
     template <bool>
-    using type = internal::fft_reorder_stage_impl<T, is_even>;
+    using type = internal::fft_reorder_stage_impl<T, cpu, is_even>;
+};
+template <typename T, cpu_t cpu, bool splitin, bool is_even, bool prefetch>
+struct fft_pruned_stage_impl_t
+{
+    template <bool>
+    using type = internal::fft_pruned_stage_impl<T, cpu, splitin, is_even, prefetch>;
+};
+template <typename T, cpu_t cpu, bool splitin, size_t size>
+struct fft_pruned_final_stage_impl_t
+{
+    template <bool>
+    using type = internal::fft_pruned_final_stage_impl<T, cpu, splitin, size>;
 };
-template <typename T, size_t log2n, bool aligned>
+template <typename T, cpu_t cpu, bool is_even>
+struct fft_pruned_reorder_stage_impl_t
+{
+    template <bool>
+    using type = internal::fft_pruned_reorder_stage_impl<T, cpu, is_even>;
+};
+template <typename T, cpu_t cpu, bool use_br2>
+struct fft_dit_stage_impl_t
+{
+    template <bool>
+    using type = internal::fft_dit_stage_impl<T, cpu, use_br2>;
+};
+template <typename T, cpu_t cpu, bool use_br2>
+struct fft_final_inverse_stage_impl_t
+{
+    template <bool>
+    using type = internal::fft_final_inverse_stage_impl<T, cpu, use_br2>;
+};
+template <typename T, cpu_t cpu, size_t log2n, bool aligned>
 struct fft_specialization_t
 {
     template <bool inverse>
-    using type = internal::fft_specialization<T, log2n, inverse>;
+    using type = internal::fft_specialization<T, cpu, log2n, inverse>;
+};
+template <typename T, cpu_t cpu, size_t radix>
+struct dft_stage_fixed_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_stage_fixed_impl<T, cpu, radix, inverse>;
+};
+template <typename T, cpu_t cpu, size_t radix>
+struct dft_stage_fixed_final_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_stage_fixed_final_impl<T, cpu, radix, inverse>;
 };
+template <typename T, cpu_t cpu>
+struct dft_chirpz_stage_impl_t
+{
+    template <bool inverse>
+    using type = internal::dft_chirpz_stage_impl<T, cpu, inverse>;
+};
+
+constexpr csizes_t<2, 3, 4, 5, 7, 8> dft_radices{};
+
+template <size_t width, bool inverse, typename T>
+KFR_INTRIN void dft_real_split_body(csize_t<width>, cbool_t<inverse>, size_t i, size_t csize, complex<T>* out,
+                                    const complex<T>* in, const complex<T>* rtwiddle)
+{
+    constexpr size_t widthm1  = width - 1;
+    const cvec<T, width> tw   = cread<width>(rtwiddle + i);
+    const cvec<T, width> fpk  = cread<width>(in + i);
+    const cvec<T, width> fpnk = reverse<2>(negodd(cread<width>(in + csize - i - widthm1)));
+
+    const cvec<T, width> f1k = fpk + fpnk;
+    const cvec<T, width> f2k = fpk - fpnk;
+    if (inverse)
+    {
+        const cvec<T, width> t = cmul_conj(f2k, tw);
+        cwrite<width>(out + i, f1k + t);
+        cwrite<width>(out + csize - i - widthm1, reverse<2>(negodd(f1k - t)));
+    }
+    else
+    {
+        const cvec<T, width> t = cmul(f2k, tw);
+        cwrite<width>(out + i, (f1k + t) * T(0.5));
+        cwrite<width>(out + csize - i - widthm1, reverse<2>(negodd((f1k - t) * T(0.5))));
+    }
+}
+
+// Converts between the spectrum of the packed N/2-point complex sequence and the half spectrum of the
+// N-point real sequence. Bins k and N/2-k are processed together, so out may be equal to in.
+// DC and Nyquist bins are left to the caller
+template <cpu_t cpu, bool inverse, typename T>
+KFR_INTRIN void dft_real_split(ccpu_t<cpu>, cbool_t<inverse>, size_t csize, complex<T>* out,
+                               const complex<T>* in, const complex<T>* rtwiddle)
+{
+    constexpr size_t width = vector_width<T, cpu>;
+    const size_t count     = (csize + 1) / 2;
+    size_t i               = 1;
+    KFR_LOOP_NOUNROLL
+    for (; i + width <= count; i += width)
+        dft_real_split_body(csize_t<width>(), cbool<inverse>, i, csize, out, in, rtwiddle);
+    KFR_LOOP_NOUNROLL
+    for (; i < count; i++)
+        dft_real_split_body(csize_t<1>(), cbool<inverse>, i, csize, out, in, rtwiddle);
+    if (csize % 2 == 0)
+    {
+        const cvec<T, 1> middle = negodd(cread<1>(in + csize / 2));
+        cwrite<1>(out + csize / 2, inverse ? middle * T(2) : middle);
+    }
+}
 }
 
 namespace dft_type
@@ -808,6 +1767,130 @@ constexpr cbools_t<true, false> direct{};
 constexpr cbools_t<false, true> inverse{};
 }
 
+enum class dft_pack_format
+{
+    Perm, // {X[0].r, X[N/2].r}, X[1], ..., X[N/2-1]
+    CCs   // X[0], X[1], ..., X[N/2]
+};
+
+/// Output order of the forward transform and input order of the inverse one
+enum class dft_order
+{
+    normal,
+    scrambled // unspecified permutation, skips the reordering pass of large power-of-two sizes
+};
+
+/// Real output of dft_plan::execute for consumers that don't need the phase
+enum class dft_spectrum
+{
+    power,     // |X|^2
+    magnitude, // |X|
+    log_power  // 10 log10 |X|^2, -inf for zero bins
+};
+
+/// How dft_plan selects between kernel variants
+enum class dft_planning
+{
+    estimate, // newest instruction set, prefetching radix-4 stages, 512 or 1024-point final stage
+    measure   // times the candidates on this machine once per size and records the fastest
+};
+
+/// Kernel variant of a plan. Measured choices are saved and restored with the wisdom files
+struct dft_plan_choice
+{
+    cpu_t cpu;
+    bool prefetch;
+    // Points of the final radix-4 stage of power-of-two plans over 256 points: 128 or 256 select the short
+    // final stage (128 for odd log2(size), 256 for even), anything else the default of 512 or 1024.
+    // Such plans store the size they use
+    size_t final_size = 0;
+};
+
+namespace internal
+{
+
+// Choices made by dft_planning::measure, keyed by element type name, size and direction
+class dft_tuning_registry
+{
+public:
+    static dft_tuning_registry& instance()
+    {
+        static dft_tuning_registry registry;
+        return registry;
+    }
+
+    bool find(const std::string& type, size_t size, int dir, dft_plan_choice& choice)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = choices.find(choice_key(type, size, dir));
+        if (it == choices.end())
+            return false;
+        choice = it->second;
+        return true;
+    }
+
+    void insert(const std::string& type, size_t size, int dir, const dft_plan_choice& choice)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        choices[choice_key(type, size, dir)] = choice;
+    }
+
+    // Calls fn(type, size, dir, choice) for every recorded choice
+    template <typename Fn>
+    void for_each(Fn&& fn)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& it : choices)
+            fn(std::get<0>(it.first), std::get<1>(it.first), std::get<2>(it.first), it.second);
+    }
+
+private:
+    using choice_key = std::tuple<std::string, size_t, int>;
+    std::mutex mutex;
+    std::map<choice_key, dft_plan_choice> choices;
+};
+
+// Conversions of dft_spectrum, from N / 2 interleaved complex values to N / 2 real values
+struct fn_power_spectrum
+{
+    template <typename T, size_t N>
+    KFR_INTRIN vec<T, N / 2> operator()(const vec<T, N>& x) const
+    {
+        const vec<T, N> square = x * x;
+        return even(square) + odd(square);
+    }
+};
+struct fn_magnitude_spectrum
+{
+    template <typename T, size_t N>
+    KFR_INTRIN vec<T, N / 2> operator()(const vec<T, N>& x) const
+    {
+        return sqrt(fn_power_spectrum()(x));
+    }
+};
+struct fn_log_power_spectrum
+{
+    template <typename T, size_t N>
+    KFR_INTRIN vec<T, N / 2> operator()(const vec<T, N>& x) const
+    {
+        return log10(fn_power_spectrum()(x)) * T(10);
+    }
+};
+
+template <cpu_t cpu, typename T, typename Fn>
+KFR_INTRIN void spectrum_convert(ccpu_t<cpu>, T* out, const complex<T>* in, size_t size, Fn&& convert)
+{
+    constexpr size_t width = vector_width<T, cpu>;
+    size_t i               = 0;
+    KFR_LOOP_NOUNROLL
+    for (; i + width <= size; i += width)
+        write(out + i, convert(cread<width>(in + i)));
+    KFR_LOOP_NOUNROLL
+    for (; i < size; i++)
+        out[i] = convert(cread<1>(in + i))[0];
+}
+}
+
 template <typename T>
 struct dft_plan
 {
@@ -815,28 +1898,44 @@ struct dft_plan
 
     size_t size;
     size_t temp_size;
+    // bytes of twiddles and other precomputed tables used by the stages. The blocks may be shared with
+    // other plans, see internal::dft_data_registry
+    size_t data_size;
+    dft_plan_choice choice;
+    dft_order order;
 
     template <bool direct = true, bool inverse = true>
-    dft_plan(size_t size, cbools_t<direct, inverse> type = dft_type::both)
-        : size(size), temp_size(0), data_size(0)
+    dft_plan(size_t size, cbools_t<direct, inverse> type = dft_type::both,
+             dft_order order = dft_order::normal)
+        : dft_plan(size, type, dft_plan_choice{ get_cpu(), true }, order)
     {
-        if (is_poweroftwo(size))
-        {
-            const size_t log2n = ilog2(size);
-            cswitch(csizes<1, 2, 3, 4, 5, 6, 7, 8>, log2n,
-                    [&](auto log2n) {
-                        add_stage<internal::fft_specialization_t<T, val_of(log2n), false>::template type>(
-                            size, type);
-                    },
-                    [&]() {
-                        cswitch(cfalse_true, is_even(log2n), [&](auto is_even) {
-                            make_fft(size, type, is_even, ctrue);
-                            add_stage<internal::fft_reorder_stage_impl_t<T, val_of(is_even)>::template type>(
-                                size, type);
-                        });
-                    });
-            initialize(type);
-        }
+    }
+    template <bool direct = true, bool inverse = true>
+    dft_plan(size_t size, cbools_t<direct, inverse> type, dft_planning planning,
+             dft_order order = dft_order::normal)
+        : dft_plan(size, type, planning == dft_planning::measure ? measure(size, type)
+                                                                 : dft_plan_choice{ get_cpu(), true },
+                   order)
+    {
+    }
+    template <bool direct = true, bool inverse = true>
+    dft_plan(size_t size, cbools_t<direct, inverse> type, const dft_plan_choice& choice,
+             dft_order order = dft_order::normal)
+        : size(size), temp_size(0), data_size(0), choice(choice), order(order)
+    {
+        // Stages are built for the newest instruction set supported by both the build and choice.cpu
+        cswitch(cpu_all, choice.cpu, [&](auto cpu) { make_plan(size, type, cpu); },
+                [&]() { make_plan(size, type, ccpu<cpu_all.back()>); }, fn_is_greaterorequal());
+    }
+    // Forward plan that skips the work ruled out by pruning, see dft_pruning
+    dft_plan(size_t size, const dft_pruning& pruning)
+        : size(size), temp_size(0), data_size(0), choice{ get_cpu(), true }, order(dft_order::normal),
+          pruning{ std::min(pruning.input_size, size), std::min(pruning.output_begin, size),
+                   std::min(pruning.output_end, size) },
+          pruned(true)
+    {
+        cswitch(cpu_all, choice.cpu, [&](auto cpu) { make_plan(size, dft_type::direct, cpu); },
+                [&]() { make_plan(size, dft_type::direct, ccpu<cpu_all.back()>); }, fn_is_greaterorequal());
     }
     KFR_INTRIN void execute(complex<T>* out, const complex<T>* in, u8* temp, bool inverse = false) const
     {
@@ -867,54 +1966,254 @@ struct dft_plan
         execute_dft(inv, out.data(), in.data(), temp.data());
     }
 
+    // Forward transform of data in place, writing the requested spectrum of size values to out.
+    // Large power-of-two plans convert in their reordering pass, which reads the digit-reversed result and
+    // writes real values in natural order, so the complex spectrum is never stored in natural order and
+    // read back. Other plans convert the result while it is still in cache. data is left in an unspecified
+    // order, out must not overlap data. Plans pruned to a range of bins write only that range of out
+    KFR_INTRIN void execute(T* out, complex<T>* data, u8* temp, dft_spectrum spectrum) const
+    {
+        switch (spectrum)
+        {
+        case dft_spectrum::power:
+            execute_spectrum(out, data, temp, internal::fn_power_spectrum());
+            break;
+        case dft_spectrum::magnitude:
+            execute_spectrum(out, data, temp, internal::fn_magnitude_spectrum());
+            break;
+        case dft_spectrum::log_power:
+            execute_spectrum(out, data, temp, internal::fn_log_power_spectrum());
+            break;
+        }
+    }
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<T, Tag1>& out, univector<complex<T>, Tag2>& data,
+                            univector<u8, Tag3>& temp, dft_spectrum spectrum) const
+    {
+        execute(out.data(), data.data(), temp.data(), spectrum);
+    }
+
+    // Executes count transforms. Transform b reads in[b * idist + i * istride] and writes out[b * size + i].
+    // Strided input (istride != 1) must not overlap out.
+    KFR_INTRIN void execute_batch(complex<T>* out, const complex<T>* in, u8* temp, size_t count,
+                                  size_t istride, size_t idist, bool inverse = false) const
+    {
+        if (inverse)
+            execute_dft_batch(ctrue, out, in, temp, count, istride, idist);
+        else
+            execute_dft_batch(cfalse, out, in, temp, count, istride, idist);
+    }
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute_batch(univector<complex<T>, Tag1>& out, const univector<complex<T>, Tag2>& in,
+                                  univector<u8, Tag3>& temp, size_t count, bool inverse = false) const
+    {
+        execute_batch(out.data(), in.data(), temp.data(), count, 1, size, inverse);
+    }
+
+    // Calls fn(block, size) for every stage data block of the plan and of the plans it is built on.
+    // A block used by both directions is passed twice
+    template <typename Fn>
+    void for_each_data(Fn&& fn) const
+    {
+        for (const auto& block : data)
+            fn(block.first, block.second);
+        for (const auto& plan : subplans)
+            plan->for_each_data(fn);
+    }
+
 private:
-    autofree<u8> data;
-    size_t data_size;
+    std::vector<std::pair<std::shared_ptr<u8>, size_t>> data;
+    // Plans used by the stages (chirp-z convolution, inverse of scrambled blocks)
+    std::vector<std::shared_ptr<const dft_plan<T>>> subplans;
     std::vector<dft_stage_ptr> stages[2];
-    template <template <bool inverse> class Stage>
-    void add_stage(size_t stage_size, cbools_t<true, true>)
+    // Nonzero if the forward radix-4 stages leave the result digit-reversed (see fft_reorder)
+    size_t reorder_log2n = 0;
+    bool reorder_br2     = false;
+    dft_pruning pruning{};
+    bool pruned = false;
+
+    // True if the plan computes only a range of bins
+    bool output_pruned() const { return pruned && (pruning.output_begin > 0 || pruning.output_end < size); }
+
+    // Times every instruction set up to the host's and, for sizes with radix-4 stages, prefetching on and off
+    // with the default and the short final stage
+    template <bool direct, bool inverse>
+    static dft_plan_choice measure(size_t size, cbools_t<direct, inverse> type)
+    {
+        internal::dft_tuning_registry& registry = internal::dft_tuning_registry::instance();
+        const int dir                           = int(direct) | int(inverse) << 1;
+        dft_plan_choice best{ get_cpu(), true };
+        if (registry.find(type_name<T>(), size, dir, best))
+            return best;
+
+        std::vector<dft_plan_choice> candidates;
+        const bool has_radix4_stages = is_poweroftwo(size) && size > 256;
+        const size_t short_final     = has_radix4_stages ? fft_final_size(is_even(ilog2(size)), true) : 0;
+        cforeach(cpu_all, [&](auto cpu) {
+            if (val_of(cpu) <= get_cpu())
+            {
+                candidates.push_back(dft_plan_choice{ val_of(cpu), true });
+                if (has_radix4_stages)
+                {
+                    candidates.push_back(dft_plan_choice{ val_of(cpu), false });
+                    candidates.push_back(dft_plan_choice{ val_of(cpu), true, short_final });
+                    candidates.push_back(dft_plan_choice{ val_of(cpu), false, short_final });
+                }
+            }
+        });
+        double best_time = 0;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            const dft_plan plan(size, type, candidates[i]);
+            const double time = plan.measure_execution(cbool<!direct>);
+            if (i == 0 || time < best_time)
+            {
+                best      = plan.choice;
+                best_time = time;
+            }
+        }
+        registry.insert(type_name<T>(), size, dir, best);
+        return best;
+    }
+
+    // Best time of several rounds of in-place transforms of zeros, which keeps denormals out
+    template <bool inverse>
+    double measure_execution(cbool_t<inverse>) const
     {
-        dft_stage<T>* direct_stage  = new Stage<false>(stage_size);
+        univector<complex<T>> buffer(size, complex<T>(0));
+        univector<u8> temp(temp_size);
+        const size_t repeats = std::max(size_t(1), size_t(65536) / size);
+        double best          = 0;
+        for (size_t round = 0; round < 5; round++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < repeats; r++)
+                execute_dft(cbool<inverse>, buffer.data(), buffer.data(), temp.data());
+            const auto stop   = std::chrono::steady_clock::now();
+            const double time = std::chrono::duration<double>(stop - start).count();
+            best              = round == 0 ? time : std::min(best, time);
+        }
+        return best;
+    }
+    template <template <bool inverse> class Stage, typename... Args>
+    void add_stage(size_t stage_size, cbools_t<true, true>, const Args&... args)
+    {
+        dft_stage<T>* direct_stage  = new Stage<false>(stage_size, args...);
         direct_stage->name          = type_name<decltype(*direct_stage)>();
-        dft_stage<T>* inverse_stage = new Stage<true>(stage_size);
+        dft_stage<T>* inverse_stage = new Stage<true>(stage_size, args...);
         inverse_stage->name         = type_name<decltype(*inverse_stage)>();
         this->data_size += direct_stage->data_size;
         this->temp_size += direct_stage->temp_size;
         stages[0].push_back(dft_stage_ptr(direct_stage));
         stages[1].push_back(dft_stage_ptr(inverse_stage));
     }
-    template <template <bool inverse> class Stage>
-    void add_stage(size_t stage_size, cbools_t<true, false>)
+    template <template <bool inverse> class Stage, typename... Args>
+    void add_stage(size_t stage_size, cbools_t<true, false>, const Args&... args)
     {
-        dft_stage<T>* direct_stage = new Stage<false>(stage_size);
+        dft_stage<T>* direct_stage = new Stage<false>(stage_size, args...);
         direct_stage->name         = type_name<decltype(*direct_stage)>();
         this->data_size += direct_stage->data_size;
         this->temp_size += direct_stage->temp_size;
         stages[0].push_back(dft_stage_ptr(direct_stage));
     }
-    template <template <bool inverse> class Stage>
-    void add_stage(size_t stage_size, cbools_t<false, true>)
+    template <template <bool inverse> class Stage, typename... Args>
+    void add_stage(size_t stage_size, cbools_t<false, true>, const Args&... args)
     {
-        dft_stage<T>* inverse_stage = new Stage<true>(stage_size);
+        dft_stage<T>* inverse_stage = new Stage<true>(stage_size, args...);
         inverse_stage->name         = type_name<decltype(*inverse_stage)>();
         this->data_size += inverse_stage->data_size;
         this->temp_size += inverse_stage->temp_size;
         stages[1].push_back(dft_stage_ptr(inverse_stage));
     }
 
-    template <bool direct, bool inverse, bool is_even, bool first>
-    void make_fft(size_t stage_size, cbools_t<direct, inverse> type, cbool_t<is_even>, cbool_t<first>)
+    template <bool direct, bool inverse, cpu_t cpu>
+    void make_plan(size_t size, cbools_t<direct, inverse> type, ccpu_t<cpu>)
+    {
+        choice.cpu = cpu;
+        if (size == 0)
+            return; // empty plan, execute does nothing
+        if (is_poweroftwo(size))
+        {
+            const size_t log2n = ilog2(size);
+            cswitch(csizes<0, 1, 2, 3, 4, 5, 6, 7, 8>, log2n,
+                    [&](auto log2n) {
+                        using specialization_t =
+                            internal::fft_specialization_t<T, cpu, val_of(log2n), false>;
+                        add_stage<specialization_t::template type>(size, type);
+                    },
+                    [&]() {
+                        reorder_log2n          = log2n;
+                        reorder_br2            = !is_even(log2n);
+                        const bool short_stage = choice.final_size != 0 && choice.final_size <= 256;
+                        choice.final_size      = fft_final_size(is_even(log2n), short_stage);
+                        cswitch(cfalse_true, is_even(log2n), [&](auto is_even) {
+                            if (order == dft_order::scrambled)
+                            {
+                                cswitch(cfalse_true, short_stage, [&](auto short_final) {
+                                    make_scrambled_fft(size, type, is_even, short_final, ccpu<cpu>);
+                                });
+                                return;
+                            }
+                            cswitch(cfalse_true, choice.prefetch, [&](auto prefetch) {
+                                cswitch(cfalse_true, short_stage, [&](auto short_final) {
+                                    make_fft(size, type, is_even, ctrue, prefetch, short_final, ccpu<cpu>);
+                                });
+                            });
+                            using reorder_t = internal::fft_reorder_stage_impl_t<T, cpu, val_of(is_even)>;
+                            using pruned_reorder_t =
+                                internal::fft_pruned_reorder_stage_impl_t<T, cpu, val_of(is_even)>;
+                            if (output_pruned())
+                                add_stage<pruned_reorder_t::template type>(size, type, size, pruning);
+                            else
+                                add_stage<reorder_t::template type>(size, type);
+                        });
+                    });
+            initialize(type);
+        }
+        else
+        {
+            if (!make_mixed_radix(size, type, ccpu<cpu>))
+            {
+                // The convolution runs on the kernels selected for this plan
+                subplans.push_back(
+                    std::make_shared<dft_plan<T>>(next_poweroftwo(size * 2 - 1), dft_type::both, choice));
+                add_stage<internal::dft_chirpz_stage_impl_t<T, cpu>::template type>(size, type,
+                                                                                     subplans.back());
+            }
+            initialize(type);
+        }
+    }
+
+    // Points of the final radix-4 stage, see dft_plan_choice::final_size
+    constexpr static size_t fft_final_size(bool is_even, bool short_final)
     {
-        constexpr size_t final_size = is_even ? 1024 : 512;
+        return is_even ? (short_final ? 256 : 1024) : (short_final ? 128 : 512);
+    }
+
+    template <bool direct, bool inverse, bool is_even, bool first, bool prefetch, bool short_final, cpu_t cpu>
+    void make_fft(size_t stage_size, cbools_t<direct, inverse> type, cbool_t<is_even>, cbool_t<first>,
+                  cbool_t<prefetch>, cbool_t<short_final>, ccpu_t<cpu>)
+    {
+        constexpr size_t final_size = fft_final_size(is_even, short_final);
 
-        using fft_stage_impl_t       = internal::fft_stage_impl_t<T, !first, is_even>;
-        using fft_final_stage_impl_t = internal::fft_final_stage_impl_t<T, !first, final_size>;
+        using fft_stage_impl_t       = internal::fft_stage_impl_t<T, cpu, !first, is_even, prefetch>;
+        using fft_final_stage_impl_t = internal::fft_final_stage_impl_t<T, cpu, !first, final_size>;
+        using pruned_stage_t         = internal::fft_pruned_stage_impl_t<T, cpu, !first, is_even, prefetch>;
+        using pruned_final_stage_t   = internal::fft_pruned_final_stage_impl_t<T, cpu, !first, final_size>;
 
-        if (stage_size >= 2048)
+        if (stage_size > final_size)
         {
-            add_stage<fft_stage_impl_t::template type>(stage_size, type);
+            if (pruned)
+                add_stage<pruned_stage_t::template type>(stage_size, type, size, pruning);
+            else
+                add_stage<fft_stage_impl_t::template type>(stage_size, type);
 
-            make_fft(stage_size / 4, cbools<direct, inverse>, cbool<is_even>, cfalse);
+            make_fft(stage_size / 4, cbools<direct, inverse>, cbool<is_even>, cfalse, cbool<prefetch>,
+                     cbool<short_final>, ccpu<cpu>);
+        }
+        else if (pruned)
+        {
+            add_stage<pruned_final_stage_t::template type>(final_size, type, size, pruning);
         }
         else
         {
@@ -922,76 +2221,531 @@ private:
         }
     }
 
-    template <bool direct, bool inverse>
-    void initialize(cbools_t<direct, inverse>)
+    // The forward transform is make_fft without the reorder stage. The inverse undoes its stages in reverse
+    // order: each final block is reordered in cache and inverted by a natural order plan, then every radix-4
+    // stage is undone by fft_dit_stage_impl
+    template <bool direct, bool inverse, bool is_even, bool short_final, cpu_t cpu>
+    void make_scrambled_fft(size_t size, cbools_t<direct, inverse>, cbool_t<is_even>, cbool_t<short_final>,
+                            ccpu_t<cpu>)
     {
-        data = autofree<u8>(data_size);
+        constexpr size_t final_size = fft_final_size(is_even, short_final);
         if (direct)
+            cswitch(cfalse_true, choice.prefetch, [&](auto prefetch) {
+                make_fft(size, cbools<true, false>, cbool<is_even>, ctrue, prefetch, cbool<short_final>,
+                         ccpu<cpu>);
+            });
+        if (inverse)
         {
-            size_t offset = 0;
-            for (dft_stage_ptr& stage : stages[0])
+            using final_inverse_t = internal::fft_final_inverse_stage_impl_t<T, cpu, !is_even>;
+            using dit_stage_t     = internal::fft_dit_stage_impl_t<T, cpu, !is_even>;
+            subplans.push_back(std::make_shared<dft_plan<T>>(final_size, dft_type::inverse, choice));
+            add_stage<final_inverse_t::template type>(final_size, cbools<false, true>, size / final_size,
+                                                      subplans.back());
+            for (size_t stage_size = final_size * 4; stage_size <= size; stage_size *= 4)
+                add_stage<dit_stage_t::template type>(stage_size, cbools<false, true>, size / stage_size);
+        }
+    }
+
+    template <bool direct, bool inverse, cpu_t cpu>
+    bool make_mixed_radix(size_t size, cbools_t<direct, inverse> type, ccpu_t<cpu>)
+    {
+        size_t radices[32];
+        size_t count = 0;
+        size_t rest  = size;
+        cforeach(csizes<8, 7, 5, 4, 3, 2>, [&](auto radix) {
+            while (count < 32 && rest % val_of(radix) == 0)
             {
-                stage->data = data.data() + offset;
-                stage->initialize(this->size);
-                offset += stage->data_size;
+                radices[count++] = val_of(radix);
+                rest /= val_of(radix);
             }
-        }
-        if (inverse)
+        });
+        // Large prime factors and sizes with more than 32 small factors are handled by the chirp-z stage
+        if (rest != 1)
+            return false;
+
+        size_t blocks     = 1;
+        size_t stage_size = size;
+        for (size_t r = 0; r < count - 1; r++)
         {
-            size_t offset = 0;
-            for (dft_stage_ptr& stage : stages[1])
+            cswitch(internal::dft_radices, radices[r], [&](auto radix) {
+                add_stage<internal::dft_stage_fixed_impl_t<T, cpu, val_of(radix)>::template type>(
+                    stage_size, type, blocks);
+            });
+            stage_size /= radices[r];
+            blocks *= radices[r];
+        }
+        cswitch(internal::dft_radices, radices[count - 1], [&](auto radix) {
+            add_stage<internal::dft_stage_fixed_final_impl_t<T, cpu, val_of(radix)>::template type>(
+                size, type, static_cast<const size_t*>(radices), count - 1);
+        });
+        return true;
+    }
+
+    // Stage data comes from the registry, so both directions of a stage point to the same block,
+    // which is also shared with stages of the same layout in other plans of this size
+    template <bool direct, bool inverse>
+    void initialize(cbools_t<direct, inverse>)
+    {
+        internal::dft_data_registry& registry = internal::dft_data_registry::instance();
+        std::unique_ptr<thread_pool> pool; // created by the first stage that needs it, shared by the rest
+        for (std::vector<dft_stage_ptr>& list : stages)
+            for (dft_stage_ptr& stage_ptr : list)
             {
-                stage->data = data.data() + offset;
-                if (!direct)
-                    stage->initialize(this->size);
-                offset += stage->data_size;
+                dft_stage<T>* stage = stage_ptr.get();
+                if (!stage->data_size)
+                    continue;
+                auto init = [&](u8* block) {
+                    if (!pool && internal::parallel_twiddles(stage->stage_size))
+                        pool.reset(new thread_pool());
+                    stage->data = block;
+                    stage->initialize(this->size, pool.get());
+                };
+                data.emplace_back(
+                    registry.get(stage->data_name, stage->stage_size, stage->data_size, init),
+                    stage->data_size);
+                stage->data = data.back().first.get();
             }
-        }
     }
     template <bool inverse>
     KFR_INTRIN void execute_dft(cbool_t<inverse>, complex<T>* out, const complex<T>* in, u8* temp) const
     {
-        size_t stack[32] = { 0 };
+        const size_t count = stages[inverse].size();
+
+        for (size_t depth = 0; depth < count;)
+        {
+            depth = execute_stages(cbool<inverse>, depth, out, in, temp);
+            in    = out;
+        }
+    }
+
+    // The forward stages without the reordering pass, then a fused reorder and conversion.
+    // Bins outside the output range of a pruned plan may be stale, so such plans run all their stages,
+    // including the reordering pass that moves only the requested bins, and convert just these
+    template <typename Fn>
+    KFR_INTRIN void execute_spectrum(T* out, complex<T>* data, u8* temp, Fn&& convert) const
+    {
+        if (output_pruned())
+        {
+            execute_dft(cfalse, data, data, temp);
+            internal::call_for_cpu(choice.cpu, [&](auto cpu) KFR_INLINE_LAMBDA {
+                internal::spectrum_convert(cpu, out + pruning.output_begin, data + pruning.output_begin,
+                                           pruning.output_end - pruning.output_begin, convert);
+            });
+            return;
+        }
+        const size_t count = stages[0].size() - (reorder_log2n && order == dft_order::normal ? 1 : 0);
+
+        for (size_t depth = 0; depth < count;)
+            depth = execute_stages(cfalse, depth, data, data, temp);
+        if (reorder_log2n)
+            cswitch(cfalse_true, reorder_br2, [&](auto use_br2) {
+                internal::fft_reorder_convert(out, data, reorder_log2n, use_br2, convert);
+            });
+        else
+            internal::call_for_cpu(choice.cpu, [&](auto cpu) KFR_INLINE_LAMBDA {
+                internal::spectrum_convert(cpu, out, data, size, convert);
+            });
+    }
 
+    // Stages are executed outermost so each stage's twiddles stay in cache for the whole batch
+    template <bool inverse>
+    KFR_INTRIN void execute_dft_batch(cbool_t<inverse>, complex<T>* out, const complex<T>* in, u8* temp,
+                                      size_t batch, size_t istride, size_t idist) const
+    {
+        if (batch == 0)
+            return;
+        if (istride != 1)
+        {
+            for (size_t b = 0; b < batch; b++)
+                for (size_t i = 0; i < size; i++)
+                    out[b * size + i] = in[b * idist + i * istride];
+            in    = out;
+            idist = size;
+        }
         const size_t count = stages[inverse].size();
 
         for (size_t depth = 0; depth < count;)
         {
-            if (stages[inverse][depth]->recursion)
+            size_t next = depth;
+            for (size_t b = 0; b < batch; b++)
+                next = execute_stages(cbool<inverse>, depth, out + b * size, in + b * idist, temp);
+            depth = next;
+            in    = out;
+            idist = size;
+        }
+    }
+
+    // Executes the stage at depth or the whole recursive group starting at it, returns the next depth
+    template <bool inverse>
+    KFR_INTRIN size_t execute_stages(cbool_t<inverse>, size_t depth, complex<T>* out, const complex<T>* in,
+                                     u8* temp) const
+    {
+        size_t stack[32] = { 0 };
+
+        const size_t count = stages[inverse].size();
+
+        if (stages[inverse][depth]->recursion)
+        {
+            complex<T>* rout      = out;
+            const complex<T>* rin = in;
+            size_t rdepth         = depth;
+            size_t maxdepth       = depth;
+            do
             {
-                complex<T>* rout      = out;
-                const complex<T>* rin = in;
-                size_t rdepth         = depth;
-                size_t maxdepth       = depth;
-                do
+                if (stack[rdepth] == stages[inverse][rdepth]->repeats)
+                {
+                    stack[rdepth] = 0;
+                    rdepth--;
+                }
+                else
                 {
-                    if (stack[rdepth] == stages[inverse][rdepth]->repeats)
-                    {
-                        stack[rdepth] = 0;
-                        rdepth--;
-                    }
+                    if (pruned)
+                        stages[inverse][rdepth]->execute(rout, rin, temp, static_cast<size_t>(rout - out));
                     else
-                    {
                         stages[inverse][rdepth]->execute(rout, rin, temp);
-                        rout += stages[inverse][rdepth]->out_offset;
-                        rin = rout;
-                        stack[rdepth]++;
-                        if (rdepth < count - 1 && stages[inverse][rdepth + 1]->recursion)
-                            rdepth++;
-                        else
-                            maxdepth = rdepth;
-                    }
-                } while (rdepth != depth);
-                depth = maxdepth + 1;
-            }
-            else
-            {
-                stages[inverse][depth]->execute(out, in, temp);
-                depth++;
-            }
-            in = out;
+                    rout += stages[inverse][rdepth]->out_offset;
+                    rin = rout;
+                    stack[rdepth]++;
+                    if (rdepth < count - 1 && stages[inverse][rdepth + 1]->recursion)
+                        rdepth++;
+                    else
+                        maxdepth = rdepth;
+                }
+            } while (rdepth != depth);
+            return maxdepth + 1;
+        }
+        else
+        {
+            stages[inverse][depth]->execute(out, in, temp);
+            return depth + 1;
+        }
+    }
+};
+
+template <typename T>
+struct dft_plan_real
+{
+    size_t size;
+    size_t temp_size;
+
+    // size must be even. Odd sizes give an empty plan with size 0, whose execute does nothing
+    template <bool direct = true, bool inverse = true>
+    dft_plan_real(size_t size, cbools_t<direct, inverse> type = dft_type::both)
+        : size(size % 2 == 0 ? size : 0), temp_size(0), plan(this->size / 2, type),
+          rtwiddle((this->size / 2 + 1) / 2)
+    {
+        temp_size = plan.temp_size;
+        // rtwiddle[k] = -i * exp(-2 * pi * i * k / size)
+        for (size_t i = 0; i < rtwiddle.size(); i++)
+        {
+            const cvec<T, 1> tw = internal::calculate_twiddle<T>(i, size);
+            rtwiddle[i]         = complex<T>(tw[1], -tw[0]);
+        }
+    }
+
+    // out must hold size / 2 + 1 values for CCs and size / 2 for Perm
+    KFR_INTRIN void execute(complex<T>* out, const T* in, u8* temp,
+                            dft_pack_format fmt = dft_pack_format::CCs) const
+    {
+        if (size == 0)
+            return;
+        const size_t csize = size / 2;
+        plan.execute(out, ptr_cast<complex<T>>(in), temp, cfalse);
+        const cvec<T, 1> dc = cread<1>(out);
+        internal::call_for_cpu(plan.choice.cpu, [&](auto cpu) KFR_INLINE_LAMBDA {
+            internal::dft_real_split(cpu, cfalse, csize, out, out, rtwiddle.data());
+        });
+        if (fmt == dft_pack_format::CCs)
+        {
+            cwrite<1>(out, make_vector(dc[0] + dc[1], T()));
+            cwrite<1>(out + csize, make_vector(dc[0] - dc[1], T()));
+        }
+        else
+        {
+            cwrite<1>(out, make_vector(dc[0] + dc[1], dc[0] - dc[1]));
+        }
+    }
+
+    // Unnormalized inverse, out receives size * x
+    KFR_INTRIN void execute(T* out, const complex<T>* in, u8* temp,
+                            dft_pack_format fmt = dft_pack_format::CCs) const
+    {
+        if (size == 0)
+            return;
+        const size_t csize = size / 2;
+        complex<T>* cout   = ptr_cast<complex<T>>(out);
+        const cvec<T, 1> dc =
+            fmt == dft_pack_format::CCs
+                ? make_vector(in[0].real() + in[csize].real(), in[0].real() - in[csize].real())
+                : make_vector(in[0].real() + in[0].imag(), in[0].real() - in[0].imag());
+        internal::call_for_cpu(plan.choice.cpu, [&](auto cpu) KFR_INLINE_LAMBDA {
+            internal::dft_real_split(cpu, ctrue, csize, cout, in, rtwiddle.data());
+        });
+        cwrite<1>(cout, dc);
+        plan.execute(cout, cout, temp, ctrue);
+    }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<complex<T>, Tag1>& out, const univector<T, Tag2>& in,
+                            univector<u8, Tag3>& temp, dft_pack_format fmt = dft_pack_format::CCs) const
+    {
+        execute(out.data(), in.data(), temp.data(), fmt);
+    }
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<T, Tag1>& out, const univector<complex<T>, Tag2>& in,
+                            univector<u8, Tag3>& temp, dft_pack_format fmt = dft_pack_format::CCs) const
+    {
+        execute(out.data(), in.data(), temp.data(), fmt);
+    }
+
+    /// Kernel variant of the complex plan of size / 2
+    const dft_plan_choice& choice() const { return plan.choice; }
+
+private:
+    dft_plan<T> plan;
+    univector<complex<T>> rtwiddle;
+};
+
+namespace internal
+{
+constexpr size_t transpose_tile = 16;
+
+template <typename T>
+KFR_INTRIN void transpose_parallel(thread_pool& pool, complex<T>* out, const complex<T>* in, size_t rows,
+                                   size_t cols)
+{
+    pool.parallel_for((rows + transpose_tile - 1) / transpose_tile, [&](size_t block, size_t) {
+        const size_t row_begin = block * transpose_tile;
+        ctranspose_block(out + row_begin, rows, in + row_begin * cols, cols,
+                         std::min(transpose_tile, rows - row_begin), cols);
+    });
+}
+}
+
+/// Four-step DFT for large sizes.
+/// The size is split into size1 * size2 and the transform runs as size2 column DFTs, twiddle multiply and
+/// size1 row DFTs with transposes in between. The sub-DFTs are independent and are spread across a thread
+/// pool owned by the plan.
+template <typename T>
+struct dft_plan_parallel
+{
+    size_t size;
+    size_t temp_size;
+
+    template <bool direct = true, bool inverse = true>
+    dft_plan_parallel(size_t size, size_t threads = thread_pool::default_concurrency(),
+                      cbools_t<direct, inverse> type = dft_type::both)
+        : size(size), temp_size(0), size1(split_size(size)), size2(size / size1), plan1(size1, type),
+          plan2(size2, type), twiddle_hi(size1), twiddle_lo(size2), pool(threads)
+    {
+        internal::fill_twiddles(twiddle_hi.data(), size1, size2, size, plan1.choice.cpu);
+        internal::fill_twiddles(twiddle_lo.data(), size2, 1, size, plan1.choice.cpu);
+        scratch_size = align_up(std::max(plan1.temp_size, plan2.temp_size), native_cache_alignment);
+        temp_size =
+            align_up(sizeof(complex<T>) * size, native_cache_alignment) + scratch_size * pool.size();
+    }
+
+    KFR_INTRIN void execute(complex<T>* out, const complex<T>* in, u8* temp, bool inverse = false) const
+    {
+        if (inverse)
+            execute_dft(ctrue, out, in, temp);
+        else
+            execute_dft(cfalse, out, in, temp);
+    }
+    template <bool inverse>
+    KFR_INTRIN void execute(complex<T>* out, const complex<T>* in, u8* temp, cbool_t<inverse> inv) const
+    {
+        execute_dft(inv, out, in, temp);
+    }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<complex<T>, Tag1>& out, const univector<complex<T>, Tag2>& in,
+                            univector<u8, Tag3>& temp, bool inverse = false) const
+    {
+        execute(out.data(), in.data(), temp.data(), inverse);
+    }
+
+private:
+    size_t size1;
+    size_t size2;
+    size_t scratch_size;
+    dft_plan<T> plan1;
+    dft_plan<T> plan2;
+    univector<complex<T>> twiddle_hi;
+    univector<complex<T>> twiddle_lo;
+    mutable thread_pool pool;
+
+    // exp(-2 * pi * i * index / size) for index < size
+    KFR_INTRIN cvec<T, 1> twiddle(size_t index) const
+    {
+        return cmul(cread<1>(twiddle_hi.data() + index / size2), cread<1>(twiddle_lo.data() + index % size2));
+    }
+
+    // Largest divisor not exceeding sqrt(size)
+    static size_t split_size(size_t size)
+    {
+        if (is_poweroftwo(size))
+            return size_t(1) << (ilog2(size) / 2);
+        size_t d = 1;
+        while ((d + 1) * (d + 1) <= size)
+            d++;
+        for (; d > 1; d--)
+            if (size % d == 0)
+                return d;
+        return 1;
+    }
+
+    template <bool inverse>
+    void execute_dft(cbool_t<inverse> inv, complex<T>* out, const complex<T>* in, u8* temp) const
+    {
+        u8* scratch = temp + align_up(sizeof(complex<T>) * size, native_cache_alignment);
+        if (size1 == 1)
+        {
+            plan2.execute(out, in, scratch, inv);
+            return;
+        }
+        complex<T>* buffer = ptr_cast<complex<T>>(temp);
+        // out is used as the working matrix unless the transform is in-place
+        complex<T>* a = in != out ? out : buffer;
+        complex<T>* b = in != out ? buffer : out;
+
+        // x[n1 * size2 + n2] -> a[n2 * size1 + n1]
+        internal::transpose_parallel(pool, a, in, size1, size2);
+        pool.parallel_for(size2, [&](size_t n2, size_t thread) {
+            complex<T>* row = a + n2 * size1;
+            plan1.execute(row, row, scratch + thread * scratch_size, inv);
+            internal::call_for_cpu(plan1.choice.cpu, [&](auto cpu) KFR_INLINE_LAMBDA {
+                constexpr size_t width = vector_width<T, val_of(cpu)>;
+                // multiply by exp(-2 * pi * i * n2 * k1 / size). For k1 = base + j this is the twiddle of
+                // n2 * j, computed once per row for every lane, times the twiddle of n2 * base
+                complex<T> lanes[width];
+                for (size_t j = 0; j < width; j++)
+                    cwrite<1>(lanes + j, twiddle(n2 * j % size));
+                const cvec<T, width> lane_twiddle = cread<width>(lanes);
+                size_t k1                         = 0;
+                KFR_LOOP_NOUNROLL
+                for (; k1 + width <= size1; k1 += width)
+                {
+                    const cvec<T, width> tw = cmul(lane_twiddle, twiddle(n2 * k1));
+                    const cvec<T, width> x  = cread<width>(row + k1);
+                    cwrite<width>(row + k1, inverse ? cmul_conj(x, tw) : cmul(x, tw));
+                }
+                KFR_LOOP_NOUNROLL
+                for (; k1 < size1; k1++)
+                {
+                    const cvec<T, 1> tw = twiddle(n2 * k1);
+                    const cvec<T, 1> x  = cread<1>(row + k1);
+                    cwrite<1>(row + k1, inverse ? cmul_conj(x, tw) : cmul(x, tw));
+                }
+            });
+        });
+        internal::transpose_parallel(pool, b, a, size2, size1);
+        pool.parallel_for(size1, [&](size_t k1, size_t thread) {
+            complex<T>* row = b + k1 * size2;
+            plan2.execute(row, row, scratch + thread * scratch_size, inv);
+        });
+        // b[k1 * size2 + k2] -> X[k2 * size1 + k1]
+        internal::transpose_parallel(pool, a, b, size1, size2);
+        if (a != out)
+        {
+            constexpr size_t block = 65536;
+            pool.parallel_for((size + block - 1) / block, [&](size_t index, size_t) {
+                const size_t start = index * block;
+                builtin_memcpy(out + start, a + start, sizeof(complex<T>) * std::min(block, size - start));
+            });
+        }
+    }
+};
+/// Multidimensional DFT of a row-major array.
+/// The last axis is transformed as a batch of contiguous rows. Other axes are processed in blocks of columns
+/// that are transposed into per-thread scratch, transformed as a batch and transposed back, so no pass
+/// transposes the whole array.
+template <typename T>
+struct dft_plan_md
+{
+    size_t size;
+    size_t temp_size;
+
+    template <bool direct = true, bool inverse = true>
+    dft_plan_md(const std::vector<size_t>& shape, cbools_t<direct, inverse> type = dft_type::both,
+                size_t threads = 1)
+        : size(1), temp_size(0), shape(shape), pool(threads)
+    {
+        constexpr size_t block = internal::transpose_tile;
+        size_t max_length      = 0;
+        size_t max_temp_size   = 0;
+        for (size_t axis = 0; axis < shape.size(); axis++)
+        {
+            size *= shape[axis];
+            std::shared_ptr<const dft_plan<T>> plan;
+            for (size_t prev = 0; prev < axis; prev++)
+                if (shape[prev] == shape[axis])
+                    plan = plans[prev];
+            if (!plan)
+                plan = std::make_shared<dft_plan<T>>(shape[axis], type);
+            plans.push_back(plan);
+            max_length    = std::max(max_length, shape[axis]);
+            max_temp_size = std::max(max_temp_size, plan->temp_size);
         }
+        plan_temp_size = align_up(max_temp_size, native_cache_alignment);
+        scratch_size =
+            align_up(sizeof(complex<T>) * max_length * block, native_cache_alignment) + plan_temp_size;
+        temp_size      = scratch_size * pool.size();
     }
+
+    KFR_INTRIN void execute(complex<T>* out, const complex<T>* in, u8* temp, bool inverse = false) const
+    {
+        if (size == 0)
+            return;
+        if (shape.empty())
+        {
+            out[0] = in[0];
+            return;
+        }
+        constexpr size_t block = internal::transpose_tile;
+        // The DFT is separable, so the contiguous axis goes first and does the out-of-place pass
+        const size_t last = shape.size() - 1;
+        const size_t rows = size / shape[last];
+        pool.parallel_for((rows + block - 1) / block, [&](size_t index, size_t thread) {
+            const size_t row   = index * block;
+            const size_t count = std::min(block, rows - row);
+            const size_t n     = shape[last];
+            plans[last]->execute_batch(out + row * n, in + row * n, temp + thread * scratch_size, count, 1, n,
+                                       inverse);
+        });
+        size_t inner = shape[last];
+        for (size_t axis = last; axis-- > 0;)
+        {
+            const size_t n      = shape[axis];
+            const size_t outer  = size / (n * inner);
+            const size_t blocks = (inner + block - 1) / block;
+            pool.parallel_for(outer * blocks, [&](size_t index, size_t thread) {
+                u8* scratch          = temp + thread * scratch_size;
+                complex<T>* columns  = ptr_cast<complex<T>>(scratch + plan_temp_size);
+                const size_t column  = index % blocks * block;
+                const size_t count   = std::min(block, inner - column);
+                complex<T>* base     = out + index / blocks * n * inner + column;
+                internal::ctranspose_block(columns, n, base, inner, n, count);
+                plans[axis]->execute_batch(columns, columns, scratch, count, 1, n, inverse);
+                internal::ctranspose_block(base, inner, columns, n, count, n);
+            });
+            inner *= n;
+        }
+    }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    KFR_INTRIN void execute(univector<complex<T>, Tag1>& out, const univector<complex<T>, Tag2>& in,
+                            univector<u8, Tag3>& temp, bool inverse = false) const
+    {
+        execute(out.data(), in.data(), temp.data(), inverse);
+    }
+
+private:
+    std::vector<size_t> shape;
+    std::vector<std::shared_ptr<const dft_plan<T>>> plans;
+    size_t plan_temp_size;
+    size_t scratch_size;
+    mutable thread_pool pool;
 };
 }
 
@@ -433,6 +433,56 @@ void transpose4(cvec<T, 16>& a, cvec<T, 16>& b, cvec<T, 16>& c, cvec<T, 16>& d,
     dd = concat(a3, b3, c3, d3);
 }
 
+template <typename T>
+KFR_INTRIN void ctranspose4x4(complex<T>* out, size_t ostride, const complex<T>* in, size_t istride)
+{
+    cvec<T, 4> w0, w1, w2, w3;
+    split(ctranspose<4>(concat(cread<4>(in), cread<4>(in + istride), cread<4>(in + istride * 2),
+                               cread<4>(in + istride * 3))),
+          w0, w1, w2, w3);
+    cwrite<4>(out, w0);
+    cwrite<4>(out + ostride, w1);
+    cwrite<4>(out + ostride * 2, w2);
+    cwrite<4>(out + ostride * 3, w3);
+}
+
+// out[j * ostride + i] = in[i * istride + j] for i < rows, j < cols
+// Cache-oblivious: halves the larger side until the block fits in cache, then uses 4x4 tiles
+template <typename T>
+void ctranspose_block(complex<T>* out, size_t ostride, const complex<T>* in, size_t istride, size_t rows,
+                      size_t cols)
+{
+    constexpr size_t leaf_size = 256;
+    if (rows * cols <= leaf_size)
+    {
+        size_t i = 0;
+        for (; i + 4 <= rows; i += 4)
+        {
+            size_t j = 0;
+            for (; j + 4 <= cols; j += 4)
+                ctranspose4x4(out + j * ostride + i, ostride, in + i * istride + j, istride);
+            for (; j < cols; j++)
+                for (size_t k = 0; k < 4; k++)
+                    out[j * ostride + i + k] = in[(i + k) * istride + j];
+        }
+        for (; i < rows; i++)
+            for (size_t j = 0; j < cols; j++)
+                out[j * ostride + i] = in[i * istride + j];
+    }
+    else if (rows >= cols)
+    {
+        const size_t half = rows / 8 * 4;
+        ctranspose_block(out, ostride, in, istride, half, cols);
+        ctranspose_block(out + half, ostride, in + half * istride, istride, rows - half, cols);
+    }
+    else
+    {
+        const size_t half = cols / 8 * 4;
+        ctranspose_block(out, ostride, in, istride, rows, half);
+        ctranspose_block(out + half * ostride, ostride, in + half, istride, rows, cols - half);
+    }
+}
+
 template <bool b, typename T>
 constexpr KFR_INTRIN T chsign(T x)
 {
@@ -1310,6 +1360,22 @@ KFR_INTRIN void butterfly_helper(std::index_sequence<I...>, size_t i, csize_t<wi
     swallow{ (cwrite<width>(out + i + stride * I, inout.get(csize<I>)), 0)... };
 }
 
+// Final, output scattered to the positions given by the dest table
+template <typename T, size_t width, size_t radix, bool inverse, size_t... I>
+KFR_INTRIN void butterfly_helper(std::index_sequence<I...>, size_t i, csize_t<width>, csize_t<radix>,
+                                 cbool_t<inverse>, complex<T>* out, const complex<T>* in, const u32* dest,
+                                 size_t stride)
+{
+    carray<cvec<T, width>, radix> inout;
+
+    cread_transposed(cbool<true>, in + i * radix, inout.get(csize<I>)...);
+
+    butterfly(cbool<inverse>, inout.get(csize<I>)..., inout.get(csize<I>)...);
+
+    const vec<u32, width> offset = read<width>(dest + i);
+    swallow{ (cscatter(out + stride * I, offset, inout.get(csize<I>)), 0)... };
+}
+
 template <size_t width, size_t radix, typename... Args>
 KFR_INTRIN void butterfly(size_t i, csize_t<width>, csize_t<radix>, Args&&... args)
 {
@@ -0,0 +1,234 @@
+/**
+ * Copyright (C) 2016 D Levin (http://www.kfrlib.com)
+ * This file is part of KFR
+ *
+ * KFR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KFR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KFR.
+ *
+ * If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+ * Buying a commercial license is mandatory as soon as you develop commercial activities without
+ * disclosing the source code of your own applications.
+ * See http://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "../base/complex.hpp"
+#include "../base/constants.hpp"
+#include "../base/memory.hpp"
+#include "../base/read_write.hpp"
+#include "../base/univector.hpp"
+#include "../base/vec.hpp"
+
+#include <cmath>
+#include <vector>
+
+#pragma clang diagnostic push
+#if CID_HAS_WARNING("-Wshadow")
+#pragma clang diagnostic ignored "-Wshadow"
+#endif
+
+namespace kfr
+{
+
+/// Goertzel detector for a set of frequencies, processed as vectors of bins: each SIMD lane runs the
+/// recurrence of one frequency. It is an output expression, so samples are fed by process, e.g.
+/// process<T>(bank, signal, size), or pushed with push(data, size)
+template <typename T>
+struct goertzel_bank : output_expression
+{
+    // Frequencies in cycles per sample, bin k of an N-point DFT is k / N
+    template <size_t Tag>
+    explicit goertzel_bank(const univector<T, Tag>& frequencies)
+        : bins(frequencies.size()), count(0), frequencies(frequencies.begin(), frequencies.end()),
+          padded(align_up(bins, width)), coefficients(padded, T()), state1(padded, T()), state2(padded, T())
+    {
+        for (size_t b = 0; b < bins; b++)
+            coefficients[b] = static_cast<T>(2 * std::cos(c_pi<double, 2> * frequencies[b]));
+    }
+
+    size_t bins;
+    // Samples processed since reset
+    size_t count;
+
+    void reset()
+    {
+        count = 0;
+        std::fill(state1.begin(), state1.end(), T());
+        std::fill(state2.begin(), state2.end(), T());
+    }
+
+    // The state of a group of bins stays in registers for the whole vector of samples
+    template <typename U, size_t N>
+    KFR_INLINE void operator()(coutput_t, size_t, vec<U, N> x)
+    {
+        KFR_LOOP_NOUNROLL
+        for (size_t b = 0; b < padded; b += width)
+        {
+            const vec<T, width> c = read<width>(coefficients.data() + b);
+            vec<T, width> s1      = read<width>(state1.data() + b);
+            vec<T, width> s2      = read<width>(state2.data() + b);
+            for (size_t i = 0; i < N; i++)
+            {
+                const vec<T, width> s0 = broadcast<width>(static_cast<T>(x[i])) + c * s1 - s2;
+                s2                     = s1;
+                s1                     = s0;
+            }
+            write(state1.data() + b, s1);
+            write(state2.data() + b, s2);
+        }
+        count += N;
+    }
+
+    void push(const T* data, size_t size)
+    {
+        size_t i = 0;
+        for (; i + width <= size; i += width)
+            (*this)(coutput, i, read<width>(data + i));
+        for (; i < size; i++)
+            (*this)(coutput, i, vec<T, 1>(data[i]));
+    }
+
+    // DFT of the samples since reset at every frequency: sum of x[n] exp(-2pi i f n)
+    void result(complex<T>* out) const
+    {
+        for (size_t b = 0; b < bins; b++)
+        {
+            const double w     = c_pi<double, 2> * frequencies[b];
+            const double re    = state1[b] * std::cos(w) - state2[b];
+            const double im    = state1[b] * std::sin(w);
+            const double phase = -c_pi<double, 2> * std::fmod(double(frequencies[b]) * double(count), 1.0);
+            const double c     = std::cos(phase);
+            const double s     = std::sin(phase);
+            out[b]             = complex<T>(static_cast<T>(re * c - im * s), static_cast<T>(re * s + im * c));
+        }
+    }
+    // |result|^2, which doesn't need the phase
+    void power(T* out) const
+    {
+        for (size_t b = 0; b < bins; b++)
+            out[b] = state1[b] * state1[b] + state2[b] * state2[b] - coefficients[b] * state1[b] * state2[b];
+    }
+
+private:
+    constexpr static size_t width = vector_width<T, cpu_t::native>;
+    univector<T> frequencies;
+    size_t padded;
+    univector<T> coefficients;
+    univector<T> state1;
+    univector<T> state2;
+};
+
+/// Sliding DFT: the DFT of the last window_size samples at a set of integer bins, updated with every
+/// sample. This is the modulated form, which accumulates (x[n] - x[n - window_size]) exp(-2pi i k n / size)
+/// and rotates to the window start only when read, so rounding errors add up instead of being multiplied
+/// by a recursive twiddle. The twiddles of all bins are tabulated by sample phase (window_size x bins
+/// values), so every sample updates the bins as vectors. Like goertzel_bank, it is an output expression
+template <typename T>
+struct sliding_dft : output_expression
+{
+    // Bins k of a window_size-point DFT, 0 <= k < window_size
+    sliding_dft(size_t window_size, const std::vector<size_t>& bin_indices)
+        : window_size(window_size), bins(bin_indices.size()), padded(align_up(bins, width)), position(0),
+          delay(window_size, T()), twiddle_re(window_size * padded, T()),
+          twiddle_im(window_size * padded, T()), sum_re(padded, T()), sum_im(padded, T())
+    {
+        for (size_t n = 0; n < window_size; n++)
+            for (size_t b = 0; b < bins; b++)
+            {
+                // exp(-2pi i k n / size) with k n reduced modulo size, exact in integers
+                const size_t k = bin_indices[b] * n % window_size;
+                twiddle_re[n * padded + b] = static_cast<T>(std::cos(c_pi<double, 2> * k / window_size));
+                twiddle_im[n * padded + b] = static_cast<T>(-std::sin(c_pi<double, 2> * k / window_size));
+            }
+    }
+
+    size_t window_size;
+    size_t bins;
+
+    void reset()
+    {
+        position = 0;
+        std::fill(delay.begin(), delay.end(), T());
+        std::fill(sum_re.begin(), sum_re.end(), T());
+        std::fill(sum_im.begin(), sum_im.end(), T());
+    }
+
+    template <typename U, size_t N>
+    KFR_INLINE void operator()(coutput_t, size_t, vec<U, N> x)
+    {
+        T difference[N];
+        for (size_t i = 0; i < N; i++)
+        {
+            const size_t slot = (position + i) % window_size;
+            const T value     = static_cast<T>(x[i]);
+            difference[i]     = value - delay[slot];
+            delay[slot]       = value;
+        }
+        KFR_LOOP_NOUNROLL
+        for (size_t b = 0; b < padded; b += width)
+        {
+            vec<T, width> re = read<width>(sum_re.data() + b);
+            vec<T, width> im = read<width>(sum_im.data() + b);
+            for (size_t i = 0; i < N; i++)
+            {
+                const size_t row      = (position + i) % window_size * padded + b;
+                const vec<T, width> d = broadcast<width>(difference[i]);
+                re += d * read<width>(twiddle_re.data() + row);
+                im += d * read<width>(twiddle_im.data() + row);
+            }
+            write(sum_re.data() + b, re);
+            write(sum_im.data() + b, im);
+        }
+        position = (position + N) % window_size;
+    }
+
+    void push(const T* data, size_t size)
+    {
+        size_t i = 0;
+        for (; i + width <= size; i += width)
+            (*this)(coutput, i, read<width>(data + i));
+        for (; i < size; i++)
+            (*this)(coutput, i, vec<T, 1>(data[i]));
+    }
+
+    // DFT of the last window_size samples (zeros before the first one), the oldest sample has index 0
+    void result(complex<T>* out) const
+    {
+        // The oldest sample is at position, multiply by conj(twiddle) of position to make it index 0
+        const size_t row = position * padded;
+        for (size_t b = 0; b < bins; b++)
+        {
+            const T wr = twiddle_re[row + b];
+            const T wi = -twiddle_im[row + b];
+            out[b]     = complex<T>(sum_re[b] * wr - sum_im[b] * wi, sum_re[b] * wi + sum_im[b] * wr);
+        }
+    }
+    void power(T* out) const
+    {
+        for (size_t b = 0; b < bins; b++)
+            out[b] = sum_re[b] * sum_re[b] + sum_im[b] * sum_im[b];
+    }
+
+private:
+    constexpr static size_t width = vector_width<T, cpu_t::native>;
+    size_t padded;
+    size_t position;
+    univector<T> delay;
+    univector<T> twiddle_re;
+    univector<T> twiddle_im;
+    univector<T> sum_re;
+    univector<T> sum_im;
+};
+}
+
+#pragma clang diagnostic pop
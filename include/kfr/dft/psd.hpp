@@ -0,0 +1,191 @@
+/**
+ * Copyright (C) 2016 D Levin (http://www.kfrlib.com)
+ * This file is part of KFR
+ *
+ * KFR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KFR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KFR.
+ *
+ * If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+ * Buying a commercial license is mandatory as soon as you develop commercial activities without
+ * disclosing the source code of your own applications.
+ * See http://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "../misc/threadpool.hpp"
+#include "fft.hpp"
+
+#include <algorithm>
+
+namespace kfr
+{
+
+enum class psd_detrend
+{
+    none,
+    mean,  // subtract the mean of each segment
+    linear // subtract the least-squares line through each segment
+};
+
+namespace internal
+{
+// acc[i] += |x[i]|^2
+template <cpu_t cpu, typename T>
+KFR_INTRIN void accumulate_power(ccpu_t<cpu>, T* acc, const complex<T>* x, size_t size)
+{
+    constexpr size_t width = vector_width<T, cpu>;
+    size_t i               = 0;
+    KFR_LOOP_NOUNROLL
+    for (; i + width <= size; i += width)
+        write(acc + i, read<width>(acc + i) + fn_power_spectrum()(cread<width>(x + i)));
+    KFR_LOOP_NOUNROLL
+    for (; i < size; i++)
+        acc[i] += fn_power_spectrum()(cread<1>(x + i))[0];
+}
+}
+
+/// Welch's power spectral density estimate: the average of the periodograms of overlapping
+/// windowed segments of a real signal. Each segment is detrended and windowed in the single pass
+/// that copies it into the FFT input, and its power spectrum is added to an accumulator of the
+/// thread that processed it, so no segment allocates. Accumulators are summed once at the end.
+/// The result is the one-sided density for a sample rate of 1 (as scipy.signal.welch computes it):
+/// multiply by 1 / sample rate for other rates.
+template <typename T>
+struct welch_plan
+{
+    // Equal to the window size
+    size_t segment_size;
+    // Distance between segment starts, segment_size - hop_size samples overlap
+    size_t hop_size;
+    // segment_size / 2 + 1 frequencies from 0 to 1/2
+    size_t bins;
+    psd_detrend detrend;
+    size_t temp_size;
+
+    // The window size must be even and nonzero and hop_size must be nonzero. Otherwise the plan is
+    // empty: segment_size and hop_size are 0, there are no segments and the estimate is 0
+    template <size_t Tag>
+    welch_plan(const univector<T, Tag>& window, size_t hop_size, psd_detrend detrend = psd_detrend::mean,
+               size_t threads = 1)
+        : segment_size(valid(window.size(), hop_size) ? window.size() : 0),
+          hop_size(segment_size ? hop_size : 0), bins(segment_size / 2 + 1), detrend(detrend), temp_size(0),
+          plan(segment_size), window(window.slice(0, segment_size)), pool(threads)
+    {
+        buffer_size   = align_up(sizeof(T) * segment_size, native_cache_alignment);
+        spectrum_size = align_up(sizeof(complex<T>) * bins, native_cache_alignment);
+        power_size    = align_up(sizeof(T) * bins, native_cache_alignment);
+        scratch_size  = buffer_size + spectrum_size + power_size +
+                       align_up(plan.temp_size, native_cache_alignment);
+        temp_size     = scratch_size * pool.size();
+
+        T window_power = 0;
+        for (size_t i = 0; i < segment_size; i++)
+            window_power += window[i] * window[i];
+        scale = T(1) / window_power;
+    }
+
+    size_t segments(size_t size) const
+    {
+        return hop_size == 0 || size < segment_size ? 0 : (size - segment_size) / hop_size + 1;
+    }
+
+    // out receives bins values
+    void execute(T* out, const T* in, size_t size, u8* temp) const
+    {
+        const size_t count = segments(size);
+        for (size_t thread = 0; thread < pool.size(); thread++)
+        {
+            T* power = thread_power(temp, thread);
+            std::fill(power, power + bins, T());
+        }
+
+        pool.parallel_for(count, [&](size_t segment, size_t thread) {
+            u8* scratch          = temp + thread * scratch_size;
+            T* buffer            = ptr_cast<T>(scratch);
+            complex<T>* spectrum = ptr_cast<complex<T>>(scratch + buffer_size);
+            prepare(buffer, in + segment * hop_size);
+            plan.execute(spectrum, buffer, scratch + buffer_size + spectrum_size + power_size);
+            internal::call_for_cpu(plan.choice().cpu, [&](auto cpu) KFR_INLINE_LAMBDA {
+                internal::accumulate_power(cpu, thread_power(temp, thread), spectrum, bins);
+            });
+        });
+
+        std::fill(out, out + bins, T());
+        for (size_t thread = 0; thread < pool.size(); thread++)
+        {
+            const T* power = thread_power(temp, thread);
+            for (size_t k = 0; k < bins; k++)
+                out[k] += power[k];
+        }
+        // Frequencies other than 0 and 1/2 also stand for their negative counterparts
+        const T norm = count ? scale / T(count) : T();
+        for (size_t k = 0; k < bins; k++)
+            out[k] *= (k == 0 || k * 2 == segment_size) ? norm : norm * T(2);
+    }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    void execute(univector<T, Tag1>& out, const univector<T, Tag2>& in, univector<u8, Tag3>& temp) const
+    {
+        execute(out.data(), in.data(), in.size(), temp.data());
+    }
+
+private:
+    size_t buffer_size;
+    size_t spectrum_size;
+    size_t power_size;
+    size_t scratch_size;
+    T scale;
+    dft_plan_real<T> plan;
+    univector<T> window;
+    mutable thread_pool pool;
+
+    static bool valid(size_t segment_size, size_t hop_size)
+    {
+        return segment_size > 0 && segment_size % 2 == 0 && hop_size > 0;
+    }
+
+    T* thread_power(u8* temp, size_t thread) const
+    {
+        return ptr_cast<T>(temp + thread * scratch_size + buffer_size + spectrum_size);
+    }
+
+    // buffer = window * (segment - trend)
+    void prepare(T* buffer, const T* segment) const
+    {
+        T offset = 0;
+        T slope  = 0;
+        if (detrend != psd_detrend::none)
+        {
+            // Least-squares line over n - center, whose sum is 0, so offset is the mean
+            const T center = T(segment_size - 1) * T(0.5);
+            T sum          = 0;
+            T weighted     = 0;
+            for (size_t n = 0; n < segment_size; n++)
+            {
+                sum += segment[n];
+                weighted += (T(n) - center) * segment[n];
+            }
+            offset = sum / T(segment_size);
+            if (detrend == psd_detrend::linear && segment_size > 1)
+            {
+                // sum of (n - center)^2 = N (N^2 - 1) / 12
+                const T n = T(segment_size);
+                slope     = weighted * T(12) / (n * (n * n - T(1)));
+            }
+            offset -= slope * center;
+        }
+        for (size_t n = 0; n < segment_size; n++)
+            buffer[n] = (segment[n] - offset - slope * T(n)) * window[n];
+    }
+};
+}
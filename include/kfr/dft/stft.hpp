@@ -0,0 +1,166 @@
+/**
+ * Copyright (C) 2016 D Levin (http://www.kfrlib.com)
+ * This file is part of KFR
+ *
+ * KFR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KFR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KFR.
+ *
+ * If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+ * Buying a commercial license is mandatory as soon as you develop commercial activities without
+ * disclosing the source code of your own applications.
+ * See http://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "../expressions/operators.hpp"
+#include "../misc/threadpool.hpp"
+#include "fft.hpp"
+
+#include <algorithm>
+
+namespace kfr
+{
+
+/// Short-time Fourier transform of a real signal with a fixed window and hop size.
+/// Frame f covers samples [f * hop_size, f * hop_size + frame_size), the window is applied while the
+/// frame is copied into the FFT input, so there are no intermediate frame copies. Frames are split
+/// among threads of an internal pool. The inverse transform is the least-squares overlap-add
+/// resynthesis, which reconstructs the signal exactly from an unmodified STFT.
+template <typename T>
+struct stft_plan
+{
+    // Equal to the window size
+    size_t frame_size;
+    size_t hop_size;
+    // frame_size / 2 + 1 bins per frame
+    size_t bins;
+    size_t temp_size;
+
+    // The window size must be even and nonzero, hop_size must be in [1, window size]. Otherwise the
+    // plan is empty: frame_size and hop_size are 0, there are no frames and execute does nothing
+    template <size_t Tag>
+    stft_plan(const univector<T, Tag>& window, size_t hop_size, size_t threads = 1)
+        : frame_size(valid(window.size(), hop_size) ? window.size() : 0), hop_size(frame_size ? hop_size : 0),
+          bins(frame_size / 2 + 1), temp_size(0), plan(frame_size), window(window.slice(0, frame_size)),
+          synthesis_window(this->window / T(frame_size)), overlap(this->hop_size), pool(threads)
+    {
+        buffer_size  = align_up(sizeof(T) * frame_size, native_cache_alignment);
+        scratch_size = buffer_size + align_up(plan.temp_size, native_cache_alignment);
+        temp_size    = scratch_size * pool.size();
+
+        // Sum of squared windows at each phase of the hop where all frames overlap
+        for (size_t i = 0; i < this->hop_size; i++)
+        {
+            T sum = 0;
+            for (size_t j = i; j < frame_size; j += this->hop_size)
+                sum += window[j] * window[j];
+            overlap[i] = sum;
+        }
+    }
+
+    // Number of frames that fit entirely in size samples
+    size_t frames(size_t size) const
+    {
+        return hop_size == 0 || size < frame_size ? 0 : (size - frame_size) / hop_size + 1;
+    }
+
+    // Number of samples covered by frames
+    size_t signal_size(size_t frames) const { return frames ? (frames - 1) * hop_size + frame_size : 0; }
+
+    // Analysis. out receives frames(size) spectra of bins values each
+    void execute(complex<T>* out, const T* in, size_t size, u8* temp) const
+    {
+        pool.parallel_for(frames(size), [&](size_t frame, size_t thread) {
+            u8* scratch = temp + thread * scratch_size;
+            T* buffer   = ptr_cast<T>(scratch);
+            make_univector(buffer, frame_size) = make_univector(in + frame * hop_size, frame_size) * window;
+            plan.execute(out + frame * bins, buffer, scratch + buffer_size);
+        });
+    }
+
+    // Synthesis. out receives signal_size(frames) samples
+    void execute(T* out, const complex<T>* in, size_t frames, u8* temp) const
+    {
+        const size_t size = signal_size(frames);
+        if (size == 0)
+            return;
+        std::fill(out, out + size, T());
+
+        // Frames that are at least frame_size apart don't overlap and are added in parallel
+        const size_t rounds = (frame_size + hop_size - 1) / hop_size;
+        for (size_t round = 0; round < rounds; round++)
+        {
+            pool.parallel_for((frames + rounds - 1 - round) / rounds, [&](size_t index, size_t thread) {
+                const size_t frame = index * rounds + round;
+                u8* scratch        = temp + thread * scratch_size;
+                T* buffer          = ptr_cast<T>(scratch);
+                plan.execute(buffer, in + frame * bins, scratch + buffer_size);
+                univector_ref<T> dst = make_univector(out + frame * hop_size, frame_size);
+                dst                  = dst + make_univector(buffer, frame_size) * synthesis_window;
+            });
+        }
+        normalize(out, frames);
+    }
+
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    void execute(univector<complex<T>, Tag1>& out, const univector<T, Tag2>& in,
+                 univector<u8, Tag3>& temp) const
+    {
+        execute(out.data(), in.data(), in.size(), temp.data());
+    }
+    template <size_t Tag1, size_t Tag2, size_t Tag3>
+    void execute(univector<T, Tag1>& out, const univector<complex<T>, Tag2>& in,
+                 univector<u8, Tag3>& temp) const
+    {
+        execute(out.data(), in.data(), in.size() / bins, temp.data());
+    }
+
+private:
+    size_t buffer_size;
+    size_t scratch_size;
+    dft_plan_real<T> plan;
+    univector<T> window;
+    // window / frame_size, the inverse FFT is unnormalized
+    univector<T> synthesis_window;
+    univector<T> overlap;
+    mutable thread_pool pool;
+
+    static bool valid(size_t frame_size, size_t hop_size)
+    {
+        return frame_size > 0 && frame_size % 2 == 0 && hop_size > 0 && hop_size <= frame_size;
+    }
+
+    // Divides each sample by the sum of squared windows of the frames covering it
+    void normalize(T* out, size_t frames) const
+    {
+        const size_t size  = signal_size(frames);
+        const size_t begin = std::min(frame_size - hop_size, size);
+        const size_t end   = std::max(frames * hop_size, begin);
+        for (size_t i = 0; i < size; i++)
+        {
+            T sum;
+            if (i >= begin && i < end)
+                sum = overlap[i % hop_size];
+            else
+            {
+                // Edges are covered by fewer frames
+                sum                = 0;
+                const size_t first = i < frame_size ? 0 : (i - frame_size) / hop_size + 1;
+                for (size_t f = first; f < frames && f * hop_size <= i; f++)
+                    sum += window[i - f * hop_size] * window[i - f * hop_size];
+            }
+            out[i] = sum > T() ? out[i] / sum : T();
+        }
+    }
+};
+}
@@ -0,0 +1,297 @@
+/**
+ * Copyright (C) 2016 D Levin (http://www.kfrlib.com)
+ * This file is part of KFR
+ *
+ * KFR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KFR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KFR.
+ *
+ * If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+ * Buying a commercial license is mandatory as soon as you develop commercial activities without
+ * disclosing the source code of your own applications.
+ * See http://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include "fft.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef KFR_OS_WIN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kfr
+{
+
+namespace internal
+{
+
+// File layout: header, block entries, choice entries, names, then the data blocks aligned to
+// wisdom_alignment. All integers are in host byte order, the file is only valid on the cpu and library
+// version it was made by
+constexpr u32 wisdom_format        = 5;
+constexpr size_t wisdom_alignment = 64;
+
+struct wisdom_header
+{
+    char magic[8];
+    u32 format;
+    u32 count;
+    u32 choice_count;
+    u32 reserved;
+    char cpu[16];
+    char version[16];
+};
+
+struct wisdom_entry
+{
+    u64 name_offset;
+    u64 name_size;
+    u64 stage_size;
+    u64 data_size;
+    u64 data_offset;
+};
+
+// Measured dft_plan_choice for an element type, size and direction
+struct wisdom_choice
+{
+    u64 name_offset;
+    u64 name_size;
+    u64 size;
+    u32 dir;
+    u32 cpu;
+    u32 prefetch;
+    u32 final_size;
+};
+
+inline void wisdom_tag(wisdom_header& header)
+{
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "KFRWISDM", 8);
+    header.format = wisdom_format;
+    std::strncpy(header.cpu, cpu_name(get_cpu()), sizeof(header.cpu) - 1);
+    std::strncpy(header.version, version_string, sizeof(header.version) - 1);
+}
+
+// Read-only view of a whole file, memory mapped where available
+struct wisdom_mapping
+{
+    wisdom_mapping(const wisdom_mapping&) = delete;
+    wisdom_mapping& operator=(const wisdom_mapping&) = delete;
+
+#ifdef KFR_OS_WIN
+    explicit wisdom_mapping(const std::string& path) : address(nullptr), size(0)
+    {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file)
+            return;
+        std::fseek(file, 0, SEEK_END);
+        const long length = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        if (length > 0)
+        {
+            address = aligned_allocate<u8>(static_cast<size_t>(length));
+            size    = std::fread(address, 1, static_cast<size_t>(length), file);
+        }
+        std::fclose(file);
+    }
+    ~wisdom_mapping()
+    {
+        if (address)
+            aligned_deallocate(address);
+    }
+#else
+    explicit wisdom_mapping(const std::string& path) : address(nullptr), size(0)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* ptr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED)
+            {
+                address = static_cast<u8*>(ptr);
+                size    = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+    ~wisdom_mapping()
+    {
+        if (address)
+            ::munmap(address, size);
+    }
+#endif
+
+    u8* address;
+    size_t size;
+};
+}
+
+/// Precomputed stage data and measured plan choices loaded by load_dft_wisdom.
+/// While it is alive, plans take matching stage data straight from the file instead of computing it.
+/// Plans keep the mapping alive, so the handle may be released once they are created
+class dft_wisdom
+{
+public:
+    size_t size() const { return blocks.size(); }
+
+private:
+    friend std::shared_ptr<const dft_wisdom> load_dft_wisdom(const std::string& path);
+    std::vector<std::shared_ptr<u8>> blocks;
+};
+
+/// Writes the precomputed data of all existing plans and all measured plan choices to path.
+/// Returns false if the file can't be written
+inline bool save_dft_wisdom(const std::string& path)
+{
+    struct choice_info
+    {
+        std::string name;
+        internal::wisdom_choice entry;
+    };
+    std::vector<choice_info> choices;
+    internal::dft_tuning_registry::instance().for_each(
+        [&](const std::string& name, size_t size, int dir, const dft_plan_choice& choice) {
+            choices.push_back(choice_info{
+                name, internal::wisdom_choice{ 0, name.size(), size, static_cast<u32>(dir),
+                                               static_cast<u32>(choice.cpu), choice.prefetch,
+                                               static_cast<u32>(choice.final_size) } });
+        });
+
+    struct block_info
+    {
+        std::string name;
+        internal::wisdom_entry entry;
+        std::shared_ptr<u8> data;
+    };
+    std::vector<block_info> infos;
+    internal::dft_data_registry::instance().for_each(
+        [&](const std::string& name, size_t stage_size, size_t data_size, const std::shared_ptr<u8>& data) {
+            const internal::wisdom_entry entry{ 0, name.size(), stage_size, data_size, 0 };
+            infos.push_back(block_info{ name, entry, data });
+        });
+
+    internal::wisdom_header header;
+    internal::wisdom_tag(header);
+    header.count        = static_cast<u32>(infos.size());
+    header.choice_count = static_cast<u32>(choices.size());
+    size_t offset       = sizeof(header) + sizeof(internal::wisdom_entry) * infos.size() +
+                    sizeof(internal::wisdom_choice) * choices.size();
+    for (block_info& info : infos)
+    {
+        info.entry.name_offset = offset;
+        offset += info.name.size();
+    }
+    for (choice_info& info : choices)
+    {
+        info.entry.name_offset = offset;
+        offset += info.name.size();
+    }
+    for (block_info& info : infos)
+    {
+        offset                 = align_up(offset, internal::wisdom_alignment);
+        info.entry.data_offset = offset;
+        offset += info.entry.data_size;
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    size_t written = std::fwrite(&header, sizeof(header), 1, file) * sizeof(header);
+    for (const block_info& info : infos)
+        written += std::fwrite(&info.entry, sizeof(info.entry), 1, file) * sizeof(info.entry);
+    for (const choice_info& info : choices)
+        written += std::fwrite(&info.entry, sizeof(info.entry), 1, file) * sizeof(info.entry);
+    for (const block_info& info : infos)
+        written += std::fwrite(info.name.data(), 1, info.name.size(), file);
+    for (const choice_info& info : choices)
+        written += std::fwrite(info.name.data(), 1, info.name.size(), file);
+    const u8 padding[internal::wisdom_alignment] = {};
+    for (const block_info& info : infos)
+    {
+        written += std::fwrite(padding, 1, info.entry.data_offset - written, file);
+        written += std::fwrite(info.data.get(), 1, info.entry.data_size, file);
+    }
+    const bool ok = std::fclose(file) == 0 && written == offset;
+    if (!ok)
+        std::remove(path.c_str());
+    return ok;
+}
+
+/// Maps a file written by save_dft_wisdom and registers its stage data for new plans.
+/// Returns nullptr if the file is missing, malformed, or was made for another cpu or library version
+inline std::shared_ptr<const dft_wisdom> load_dft_wisdom(const std::string& path)
+{
+    std::shared_ptr<internal::wisdom_mapping> mapping = std::make_shared<internal::wisdom_mapping>(path);
+    const u8* address = mapping->address;
+    const size_t size = mapping->size;
+
+    internal::wisdom_header expected;
+    internal::wisdom_tag(expected);
+    internal::wisdom_header header;
+    if (size < sizeof(header))
+        return nullptr;
+    std::memcpy(&header, address, sizeof(header));
+    header.count        = expected.count;
+    header.choice_count = expected.choice_count;
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0)
+        return nullptr;
+    std::memcpy(&header, address, sizeof(header));
+    if (header.count > (size - sizeof(header)) / sizeof(internal::wisdom_entry) ||
+        header.choice_count > (size - sizeof(header) - sizeof(internal::wisdom_entry) * header.count) /
+                                  sizeof(internal::wisdom_choice))
+        return nullptr;
+
+    std::shared_ptr<dft_wisdom> wisdom(new dft_wisdom());
+    std::vector<internal::wisdom_entry> entries(header.count);
+    std::memcpy(entries.data(), address + sizeof(header), sizeof(internal::wisdom_entry) * header.count);
+    for (const internal::wisdom_entry& e : entries)
+    {
+        if (e.name_offset > size || e.name_size > size - e.name_offset || e.data_offset > size ||
+            e.data_size > size - e.data_offset || e.data_offset % internal::wisdom_alignment != 0)
+            return nullptr;
+        wisdom->blocks.push_back(std::shared_ptr<u8>(mapping, mapping->address + e.data_offset));
+    }
+    std::vector<internal::wisdom_choice> choices(header.choice_count);
+    std::memcpy(choices.data(), address + sizeof(header) + sizeof(internal::wisdom_entry) * header.count,
+                sizeof(internal::wisdom_choice) * header.choice_count);
+    for (const internal::wisdom_choice& c : choices)
+        if (c.name_offset > size || c.name_size > size - c.name_offset ||
+            c.cpu > static_cast<u32>(cpu_t::highest))
+            return nullptr;
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const internal::wisdom_entry& e = entries[i];
+        const std::string name(reinterpret_cast<const char*>(address + e.name_offset), e.name_size);
+        internal::dft_data_registry::instance().insert(name, e.stage_size, e.data_size, wisdom->blocks[i]);
+    }
+    for (const internal::wisdom_choice& c : choices)
+    {
+        const std::string name(reinterpret_cast<const char*>(address + c.name_offset), c.name_size);
+        const dft_plan_choice choice{ static_cast<cpu_t>(c.cpu), c.prefetch != 0, c.final_size };
+        internal::dft_tuning_registry::instance().insert(name, c.size, static_cast<int>(c.dir), choice);
+    }
+    return wisdom;
+}
+}
@@ -247,8 +247,9 @@ cpu_t detect_cpu()
     c.hasAVX512OSSUPPORT = c.hasAVX512F && c.hasOSXSAVE && (xcr0 & 0xE0) == 0xE0;
 
 #ifdef KFR_AVAIL_AVX512
-    if (c.hasAVX512F && c.hasAVX512BW && c.hasAVX512DQ && c.hasAVX512OSSUPPORT)
-        return cpu_t::avx3;
+    if (c.hasAVX512F && c.hasAVX512CD && c.hasAVX512BW && c.hasAVX512DQ && c.hasAVXOSSUPPORT &&
+        c.hasAVX512OSSUPPORT)
+        return cpu_t::avx512;
 #endif
 #ifdef KFR_AVAIL_AVX2
     if (c.hasAVX2 && c.hasAVXOSSUPPORT)
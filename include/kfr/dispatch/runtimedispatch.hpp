@@ -80,6 +80,13 @@ auto with_cpu_impl(ccpu_t<cpu_t::avx2>, Fn&& fn, Args&&... args)
 {
     return fn(std::forward<Args>(args)...);
 }
+
+template <typename Fn, typename... Args>
+KFR_CPU_INTRIN(avx512)
+auto with_cpu_impl(ccpu_t<cpu_t::avx512>, Fn&& fn, Args&&... args)
+{
+    return fn(std::forward<Args>(args)...);
+}
 }
 
 template <cpu_t cpu, typename Fn, typename... Args>
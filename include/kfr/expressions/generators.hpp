@@ -26,8 +26,11 @@
 #include "../base/log_exp.hpp"
 #include "../base/select.hpp"
 #include "../base/sin_cos.hpp"
+#include "../base/sqrt.hpp"
 #include "../base/vec.hpp"
 
+#include <limits>
+
 #pragma clang diagnostic push
 #if CID_HAS_WARNING("-Winaccessible-base")
 #pragma clang diagnostic ignored "-Winaccessible-base"
@@ -36,17 +39,25 @@
 namespace kfr
 {
 
+enum class window_symmetry
+{
+    symmetric, // w[0] == w[size - 1], for filter design
+    periodic   // one period of a size-periodic window, for spectral analysis
+};
+
 namespace internal
 {
 
 template <cpu_t cpu = cpu_t::native>
-struct in_generators : in_log_exp<cpu>, in_select<cpu>, in_sin_cos<cpu>
+struct in_generators : in_log_exp<cpu>, in_select<cpu>, in_sin_cos<cpu>, in_sqrt<cpu>
 {
 private:
     using in_log_exp<cpu>::exp;
     using in_log_exp<cpu>::exp2;
     using in_select<cpu>::select;
     using in_sin_cos<cpu>::cossin;
+    using in_sin_cos<cpu>::cos;
+    using in_sqrt<cpu>::sqrt;
 
 public:
     template <typename T, size_t width_, typename Class>
@@ -246,6 +257,133 @@ public:
         T beta;
         mutable vec<T, width> cos_value;
     };
+
+    // Windows are computed from the sample index, so they have a size, can be read in any order
+    // and are fused into expressions without a table
+    template <typename T, typename Class>
+    struct window_generator : input_expression
+    {
+        using value_type = T;
+        using size_type  = size_t;
+
+        window_generator(size_t size, window_symmetry symmetry)
+            : m_size(size), origin(size > 1 ? T(0) : T(0.5)),
+              step(size > 1 ? T(1) / T(symmetry == window_symmetry::symmetric ? size - 1 : size) : T(0))
+        {
+        }
+
+        constexpr size_t size() const noexcept { return m_size; }
+
+        template <typename U, size_t N>
+        KFR_INLINE vec<U, N> operator()(cinput_t, size_t index, vec_t<U, N>) const
+        {
+            // Position in the window, 0 for the first sample and 1 for the last symmetric one
+            const vec<T, N> x = origin + (enumerate<T, N>() + T(index)) * step;
+            return cast<U>(static_cast<const Class*>(this)->get(x));
+        }
+
+    protected:
+        size_t m_size;
+        T origin;
+        T step;
+    };
+
+    // a[0] - a[1] cos(2 pi x) + a[2] cos(4 pi x) - ...
+    template <typename T, size_t terms>
+    struct window_cosine_sum : window_generator<T, window_cosine_sum<T, terms>>
+    {
+        template <cpu_t newcpu>
+        using retarget_this = typename in_generators<newcpu>::template window_cosine_sum<T, terms>;
+
+        window_cosine_sum(size_t size, window_symmetry symmetry, const T (&coefficients)[terms])
+            : window_generator<T, window_cosine_sum<T, terms>>(size, symmetry)
+        {
+            for (size_t k = 0; k < terms; k++)
+                this->coefficients[k] = k % 2 ? -coefficients[k] : coefficients[k];
+        }
+
+        template <size_t N>
+        KFR_INLINE vec<T, N> get(vec<T, N> x) const
+        {
+            // cos(2 pi k x) by the Chebyshev recurrence, so there is a single cos per sample
+            const vec<T, N> c1 = cos(x * c_pi<T, 2>);
+            vec<T, N> previous = T(1);
+            vec<T, N> current  = c1;
+            vec<T, N> result   = coefficients[0] + coefficients[1] * c1;
+            for (size_t k = 2; k < terms; k++)
+            {
+                const vec<T, N> next = T(2) * c1 * current - previous;
+                previous             = current;
+                current              = next;
+                result += coefficients[k] * current;
+            }
+            return result;
+        }
+
+    protected:
+        T coefficients[terms];
+    };
+
+    // I0(beta sqrt(1 - (2x - 1)^2)) / I0(beta)
+    template <typename T>
+    struct window_kaiser : window_generator<T, window_kaiser<T>>
+    {
+        template <cpu_t newcpu>
+        using retarget_this = typename in_generators<newcpu>::template window_kaiser<T>;
+
+        window_kaiser(size_t size, T beta, window_symmetry symmetry)
+            : window_generator<T, window_kaiser<T>>(size, symmetry), beta(beta), terms(bessel_i0_terms(beta)),
+              scale(T(1) / bessel_i0(make_vector(beta), terms)[0])
+        {
+        }
+
+        template <size_t N>
+        KFR_INLINE vec<T, N> get(vec<T, N> x) const
+        {
+            const vec<T, N> t    = x * T(2) - T(1);
+            const vec<T, N> r    = (T(1) - t) * (T(1) + t);
+            const vec<T, N> zero = T(0);
+            // x may exceed 1 by rounding
+            return bessel_i0(beta * sqrt(select(r > zero, r, zero)), terms) * scale;
+        }
+
+    protected:
+        T beta;
+        size_t terms;
+        T scale;
+
+        // Modified Bessel function of the first kind of order 0 as the series
+        // sum of ((x / 2)^k / k!)^2, whose terms are all positive, truncated to count terms
+        template <size_t N>
+        KFR_SINTRIN vec<T, N> bessel_i0(vec<T, N> x, size_t count)
+        {
+            const vec<T, N> q = x * x * T(0.25);
+            vec<T, N> term    = T(1);
+            vec<T, N> sum     = T(1);
+            for (size_t k = 1; k < count; k++)
+            {
+                term = term * q * T(1.0 / (k * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // Terms needed for full precision at the largest argument, the series converges faster for
+        // smaller ones
+        static size_t bessel_i0_terms(T beta)
+        {
+            const double q = double(beta) * double(beta) * 0.25;
+            double term    = 1;
+            double sum     = 1;
+            size_t k       = 1;
+            for (; k < 1000 && term > std::numeric_limits<T>::epsilon() * sum * 0.5; k++)
+            {
+                term *= q / double(k * k);
+                sum += term;
+            }
+            return k;
+        }
+    };
 };
 }
 
@@ -274,6 +412,43 @@ KFR_SINTRIN internal::in_generators<>::generator_sin<TF> gen_sin(T1 start, T2 st
 {
     return internal::in_generators<>::generator_sin<TF>(start, step);
 }
+
+template <typename T = fbase>
+KFR_SINTRIN internal::in_generators<>::window_cosine_sum<T, 2> window_hann(
+    size_t size, window_symmetry symmetry = window_symmetry::symmetric)
+{
+    const T coefficients[] = { T(0.5), T(0.5) };
+    return internal::in_generators<>::window_cosine_sum<T, 2>(size, symmetry, coefficients);
+}
+template <typename T = fbase>
+KFR_SINTRIN internal::in_generators<>::window_cosine_sum<T, 2> window_hamming(
+    size_t size, window_symmetry symmetry = window_symmetry::symmetric)
+{
+    const T coefficients[] = { T(0.54), T(0.46) };
+    return internal::in_generators<>::window_cosine_sum<T, 2>(size, symmetry, coefficients);
+}
+template <typename T = fbase>
+KFR_SINTRIN internal::in_generators<>::window_cosine_sum<T, 3> window_blackman(
+    size_t size, window_symmetry symmetry = window_symmetry::symmetric)
+{
+    const T coefficients[] = { T(0.42), T(0.5), T(0.08) };
+    return internal::in_generators<>::window_cosine_sum<T, 3>(size, symmetry, coefficients);
+}
+// Five-term flat top window (coefficients as in MATLAB flattopwin)
+template <typename T = fbase>
+KFR_SINTRIN internal::in_generators<>::window_cosine_sum<T, 5> window_flattop(
+    size_t size, window_symmetry symmetry = window_symmetry::symmetric)
+{
+    const T coefficients[] = { T(0.21557895), T(0.41663158), T(0.277263158), T(0.083578947),
+                               T(0.006947368) };
+    return internal::in_generators<>::window_cosine_sum<T, 5>(size, symmetry, coefficients);
+}
+template <typename T = fbase>
+KFR_SINTRIN internal::in_generators<>::window_kaiser<T> window_kaiser(
+    size_t size, identity<T> beta = T(0.5), window_symmetry symmetry = window_symmetry::symmetric)
+{
+    return internal::in_generators<>::window_kaiser<T>(size, beta, symmetry);
+}
 }
 
 #pragma clang diagnostic pop
@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2016 D Levin (http://www.kfrlib.com)
+ * This file is part of KFR
+ *
+ * KFR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KFR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KFR.
+ *
+ * If GPL is not suitable for your project, you must purchase a commercial license to use KFR.
+ * Buying a commercial license is mandatory as soon as you develop commercial activities without
+ * disclosing the source code of your own applications.
+ * See http://www.kfrlib.com for details.
+ */
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kfr
+{
+
+/// Fixed set of worker threads executing parallel loops.
+/// The calling thread takes part in each loop as thread 0, so a pool of size 1 has no workers.
+class thread_pool
+{
+public:
+    static size_t default_concurrency()
+    {
+        const size_t threads = std::thread::hardware_concurrency();
+        return threads ? threads : 1;
+    }
+
+    explicit thread_pool(size_t threads = default_concurrency())
+        : stopping(false), generation(0), pending(0)
+    {
+        for (size_t i = 1; i < threads; i++)
+            workers.emplace_back([this, i]() { worker(i); });
+    }
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+    }
+
+    size_t size() const { return workers.size() + 1; }
+
+    /// Calls fn(index, thread) for each index in [0, count) and waits for completion.
+    /// thread is in [0, size()) and identifies the executing thread, e.g. to select per-thread scratch.
+    template <typename Fn>
+    void parallel_for(size_t count, Fn&& fn)
+    {
+        if (workers.empty() || count <= 1)
+        {
+            for (size_t i = 0; i < count; i++)
+                fn(i, size_t(0));
+            return;
+        }
+        std::lock_guard<std::mutex> serialize(loop_mutex);
+        std::atomic<size_t> next(0);
+        auto body = [&](size_t thread) {
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+                fn(i, thread);
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job     = std::ref(body);
+            pending = workers.size();
+            generation++;
+        }
+        wakeup.notify_all();
+        body(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+        job = nullptr;
+    }
+
+private:
+    void worker(size_t thread)
+    {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wakeup.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen                                 = generation;
+            const std::function<void(size_t)> fn = job;
+            lock.unlock();
+            fn(thread);
+            lock.lock();
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex loop_mutex;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable done;
+    std::function<void(size_t)> job;
+    bool stopping;
+    size_t generation;
+    size_t pending;
+};
+}
@@ -47,9 +47,16 @@ set(
     ${PROJECT_SOURCE_DIR}/include/kfr/data/bitrev.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/data/sincos.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/dft/bitrev.hpp
+    ${PROJECT_SOURCE_DIR}/include/kfr/dft/cache.hpp
+    ${PROJECT_SOURCE_DIR}/include/kfr/dft/conv.hpp
+    ${PROJECT_SOURCE_DIR}/include/kfr/dft/dct.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/dft/fft.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/dft/ft.hpp
+    ${PROJECT_SOURCE_DIR}/include/kfr/dft/goertzel.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/dft/reference_dft.hpp
+    ${PROJECT_SOURCE_DIR}/include/kfr/dft/psd.hpp
+    ${PROJECT_SOURCE_DIR}/include/kfr/dft/stft.hpp
+    ${PROJECT_SOURCE_DIR}/include/kfr/dft/wisdom.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/dispatch/cpuid.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/dispatch/runtimedispatch.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/expressions/basic.hpp
@@ -67,6 +74,7 @@ set(
     ${PROJECT_SOURCE_DIR}/include/kfr/misc/random.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/misc/small_buffer.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/misc/sort.hpp
+    ${PROJECT_SOURCE_DIR}/include/kfr/misc/threadpool.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/vec.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/version.hpp
     ${PROJECT_SOURCE_DIR}/include/kfr/base/kfr.h
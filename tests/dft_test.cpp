@@ -11,9 +11,17 @@
 
 #include "testo/testo.hpp"
 #include <kfr/cometa/string.hpp>
+#include <kfr/dft/cache.hpp>
+#include <kfr/dft/conv.hpp>
+#include <kfr/dft/dct.hpp>
 #include <kfr/dft/fft.hpp>
+#include <kfr/dft/goertzel.hpp>
+#include <kfr/dft/psd.hpp>
 #include <kfr/dft/reference_dft.hpp>
+#include <kfr/dft/stft.hpp>
+#include <kfr/dft/wisdom.hpp>
 #include <kfr/expressions/basic.hpp>
+#include <kfr/expressions/generators.hpp>
 #include <kfr/expressions/operators.hpp>
 #include <kfr/expressions/reduce.hpp>
 #include <kfr/io/tostring.hpp>
@@ -23,6 +31,49 @@
 
 using namespace kfr;
 
+TEST(vector_alignment)
+{
+    // Static univectors are aligned for the widest vectors the dispatcher can select
+    constexpr size_t width = vector_width<float, cpu_t::avx512>;
+    univector<float, width * 4> data;
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = float(i);
+    CHECK(maximum_vector_alignment >= sizeof(vec<float, width>));
+    CHECK(reinterpret_cast<uintptr_t>(data.data()) % maximum_vector_alignment == 0);
+    for (size_t i = 0; i < data.size(); i += width)
+    {
+        const vec<float, width> v = read<width, true>(data.data() + i);
+        CHECK(v[0] == float(i));
+        CHECK(v[width - 1] == float(i + width - 1));
+    }
+}
+
+TEST(fft_twiddles)
+{
+    // Tables filled from the first octant match direct evaluation of every twiddle for every
+    // instruction set supported here
+    // count, step, size
+    const size_t cases[][3] = { { 8, 1, 8 },      { 1000, 1, 1000 }, { 4096, 1, 4096 },
+                                { 64, 64, 4096 }, { 100, 3, 512 } };
+    cforeach(cpu_all, [&](auto cpu) {
+        if (val_of(cpu) > get_cpu())
+            return;
+        for (const auto& s : cases)
+        {
+            univector<complex<double>> tw(s[0]);
+            internal::fill_twiddles(tw.data(), s[0], s[1], s[2], val_of(cpu));
+            double error = 0;
+            for (size_t i = 0; i < tw.size(); i++)
+            {
+                const cvec<double, 1> ref = internal::calculate_twiddle<double>(i * s[1] % s[2], s[2]);
+                error = std::max(error, std::abs(tw[i].real() - ref[0]));
+                error = std::max(error, std::abs(tw[i].imag() - ref[1]));
+            }
+            CHECK(error < 1e-15);
+        }
+    });
+}
+
 TEST(fft_accuracy)
 {
     testo::active_test()->show_progress = true;
@@ -52,9 +103,1059 @@ TEST(fft_accuracy)
                   });
 }
 
+TEST(fft_accuracy_any_size)
+{
+    testo::active_test()->show_progress = true;
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")    = ctypes<float, double>, //
+                  named("inverse") = std::make_tuple(false, true), //
+                  named("size")    = std::vector<size_t>{ 0,   3,   5,   6,   7,    11,   12,   13,   15,  35,
+                                                       60,  97,  105, 121, 240, 960,  1009, 1920, 2018, 2400 },
+                  [&gen](auto type, bool inverse, size_t size) {
+                      using float_type = type_of<decltype(type)>;
+
+                      univector<complex<float_type>> in =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      univector<complex<float_type>> out    = in;
+                      univector<complex<float_type>> refout = out;
+                      const dft_plan<float_type> dft(size);
+                      univector<u8> temp(dft.temp_size);
+                      if (size == 0)
+                      {
+                          // Empty plan
+                          CHECK(dft.temp_size == 0);
+                          dft.execute(out, out, temp, inverse);
+                          return;
+                      }
+
+                      reference_dft(refout.data(), in.data(), size, inverse);
+                      dft.execute(out, out, temp, inverse);
+
+                      const float_type rms_diff = rms(cabs(refout - out));
+                      const double ops          = std::log2(size) * 100;
+                      const double epsilon      = std::numeric_limits<float_type>::epsilon();
+                      CHECK(rms_diff < epsilon * ops);
+                  });
+}
+
+TEST(fft_real_accuracy)
+{
+    testo::active_test()->show_progress = true;
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    // Odd sizes give an empty plan
+    CHECK(dft_plan_real<float>(15).size == 0);
+    CHECK(dft_plan_real<double>(1).size == 0);
+
+    testo::matrix(named("type") = ctypes<float, double>, //
+                  named("size") = std::vector<size_t>{ 4, 6, 8, 10, 14, 30, 64, 250, 1024, 4096, 4802 },
+                  [&gen](auto type, size_t size) {
+                      using float_type   = type_of<decltype(type)>;
+                      const size_t csize = size / 2;
+
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+                      univector<complex<float_type>> cin(size);
+                      for (size_t i = 0; i < size; i++)
+                          cin[i] = complex<float_type>(in[i], 0);
+                      univector<complex<float_type>> refout(size);
+                      reference_dft(refout.data(), cin.data(), size, false);
+
+                      const dft_plan_real<float_type> dft(size);
+                      univector<u8> temp(dft.temp_size);
+                      univector<complex<float_type>> out(csize + 1);
+                      univector<complex<float_type>> perm(csize);
+                      dft.execute(out, in, temp, dft_pack_format::CCs);
+                      dft.execute(perm, in, temp, dft_pack_format::Perm);
+
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      const double ops     = std::log2(size) * 100;
+                      CHECK(rms(cabs(refout.slice(0, csize + 1) - out)) < epsilon * ops);
+                      CHECK(rms(cabs(refout.slice(1, csize - 1) - perm.slice(1, csize - 1))) <
+                            epsilon * ops);
+                      CHECK(std::abs(perm[0].real() - refout[0].real()) < epsilon * ops);
+                      CHECK(std::abs(perm[0].imag() - refout[csize].real()) < epsilon * ops);
+
+                      univector<float_type> back(size);
+                      dft.execute(back, out, temp, dft_pack_format::CCs);
+                      CHECK(rms(back / float_type(size) - in) < epsilon * ops);
+                  });
+}
+
+TEST(fft_parallel_accuracy)
+{
+    testo::active_test()->show_progress = true;
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")    = ctypes<float, double>, //
+                  named("inverse") = std::make_tuple(false, true), //
+                  named("size")    = std::vector<size_t>{ 97, 256, 1000, 2048, 4096, 4800 },
+                  [&gen](auto type, bool inverse, size_t size) {
+                      using float_type = type_of<decltype(type)>;
+
+                      univector<complex<float_type>> in =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      univector<complex<float_type>> out    = in;
+                      univector<complex<float_type>> refout = out;
+                      const dft_plan_parallel<float_type> dft(size, 4);
+                      univector<u8> temp(dft.temp_size);
+
+                      reference_dft(refout.data(), in.data(), size, inverse);
+                      dft.execute(out, out, temp, inverse);
+
+                      const double ops     = std::log2(size) * 100;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      CHECK(rms(cabs(refout - out)) < epsilon * ops);
+
+                      univector<complex<float_type>> out2(size);
+                      dft.execute(out2, in, temp, inverse);
+                      CHECK(rms(cabs(refout - out2)) < epsilon * ops);
+                  });
+}
+
+TEST(fft_scrambled)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type") = ctypes<float, double>, //
+                  named("size") = std::vector<size_t>{ 60, 256, 512, 1024, 2048, 4096, 32768, 65536 },
+                  [&gen](auto type, size_t size) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double ops     = std::log2(size) * 100;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      univector<complex<float_type>> x =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      univector<complex<float_type>> h =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      const dft_plan<float_type> natural(size);
+                      const dft_plan<float_type> scrambled(size, dft_type::both, dft_order::scrambled);
+                      univector<u8> temp(std::max(natural.temp_size, scrambled.temp_size));
+
+                      // Circular convolution through both orders
+                      univector<complex<float_type>> xs(size);
+                      univector<complex<float_type>> hs(size);
+                      univector<complex<float_type>> ref(size);
+                      univector<complex<float_type>> out(size);
+                      natural.execute(xs, x, temp);
+                      natural.execute(hs, h, temp);
+                      xs = xs * hs;
+                      natural.execute(ref, xs, temp, true);
+
+                      scrambled.execute(xs, x, temp);
+                      scrambled.execute(hs, h, temp);
+                      xs = xs * hs;
+                      scrambled.execute(out, xs, temp, true);
+                      const double magnitude = rms(cabs(ref));
+                      CHECK(rms(cabs(ref - out)) < epsilon * ops * magnitude);
+
+                      scrambled.execute(out, out, temp);
+                      scrambled.execute(out, out, temp, true);
+                      CHECK(rms(cabs(ref - out / float_type(size))) < epsilon * ops * magnitude);
+                  });
+}
+
+TEST(fft_short_final)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type") = ctypes<float, double>, //
+                  named("size") = std::vector<size_t>{ 512, 1024, 2048, 4096, 65536 },
+                  [&gen](auto type, size_t size) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double ops     = std::log2(size) * 100;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      univector<complex<float_type>> in =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      const dft_plan<float_type> natural(size);
+                      // 128 selects the short final stage of either parity
+                      const dft_plan_choice choice{ get_cpu(), true, 128 };
+                      const dft_plan<float_type> short_final(size, dft_type::both, choice);
+                      const dft_plan<float_type> scrambled(size, dft_type::both, choice,
+                                                           dft_order::scrambled);
+                      CHECK(natural.choice.final_size == (ilog2(size) % 2 ? 512 : 1024));
+                      CHECK(short_final.choice.final_size == (ilog2(size) % 2 ? 128 : 256));
+                      univector<u8> temp(
+                          std::max(std::max(natural.temp_size, short_final.temp_size), scrambled.temp_size));
+
+                      univector<complex<float_type>> ref(size);
+                      univector<complex<float_type>> out(size);
+                      natural.execute(ref, in, temp);
+                      short_final.execute(out, in, temp);
+                      const double magnitude = rms(cabs(ref));
+                      CHECK(rms(cabs(ref - out)) < epsilon * ops * magnitude);
+
+                      short_final.execute(out, out, temp, true);
+                      CHECK(rms(cabs(in - out / float_type(size))) < epsilon * ops);
+
+                      scrambled.execute(out, in, temp);
+                      scrambled.execute(out, out, temp, true);
+                      CHECK(rms(cabs(in - out / float_type(size))) < epsilon * ops);
+                  });
+}
+
+TEST(fft_reorder_blocked)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")       = ctypes<float, double>, //
+                  named("log2(size)") = make_range(10, 20), //
+                  [&gen](auto type, size_t log2size) {
+                      using float_type  = type_of<decltype(type)>;
+                      const size_t size = size_t(1) << log2size;
+
+                      univector<complex<float_type>> swapped =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      univector<complex<float_type>> blocked = swapped;
+                      if (log2size % 2)
+                      {
+                          internal::fft_reorder_swaps(swapped.data(), log2size, ctrue);
+                          internal::fft_reorder_blocked(blocked.data(), log2size, ctrue);
+                      }
+                      else
+                      {
+                          internal::fft_reorder_swaps(swapped.data(), log2size, cfalse);
+                          internal::fft_reorder_blocked(blocked.data(), log2size, cfalse);
+                      }
+                      CHECK(rms(cabs(swapped - blocked)) == 0);
+                  });
+}
+
+TEST(fft_spectrum)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    const dft_order orders[] = { dft_order::normal, dft_order::scrambled };
+    testo::matrix(named("type")  = ctypes<float, double>, //
+                  named("order") = std::vector<size_t>{ 0, 1 }, //
+                  named("size")  = std::vector<size_t>{ 16, 60, 512, 1024, 4096, 65536 },
+                  [&](auto type, size_t order_index, size_t size) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double ops     = std::log2(size) * 100;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      const univector<complex<float_type>> in =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      const dft_plan<float_type> natural(size);
+                      const dft_plan<float_type> plan(size, dft_type::both, orders[order_index]);
+                      univector<u8> temp(std::max(natural.temp_size, plan.temp_size));
+                      univector<complex<float_type>> spectrum(size);
+                      natural.execute(spectrum, in, temp);
+                      const univector<float_type> magnitude = cabs(spectrum);
+                      const univector<float_type> power     = magnitude * magnitude;
+                      const double scale                    = rms(power);
+
+                      univector<complex<float_type>> data(size);
+                      univector<float_type> out(size);
+                      data = in;
+                      plan.execute(out, data, temp, dft_spectrum::power);
+                      CHECK(rms(power - out) < epsilon * ops * scale);
+                      data = in;
+                      plan.execute(out, data, temp, dft_spectrum::magnitude);
+                      CHECK(rms(magnitude - out) < epsilon * ops * rms(magnitude));
+                      data = in;
+                      plan.execute(out, data, temp, dft_spectrum::log_power);
+                      double error = 0;
+                      for (size_t i = 0; i < size; i++)
+                          error = std::max(error, std::abs(10 * std::log10(double(power[i])) - out[i]) *
+                                                      power[i] / scale);
+                      CHECK(error < epsilon * ops * 10);
+                  });
+}
+
+TEST(fft_pruned)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")  = ctypes<float, double>, //
+                  named("size")  = std::vector<size_t>{ 60, 256, 512, 2048, 8192, 65536 }, //
+                  named("input") = std::vector<size_t>{ 1, 2, 16 }, //
+                  [&gen](auto type, size_t size, size_t input_fraction) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double ops     = std::log2(size) * 100;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      // Zero padded input, bins from a range that doesn't start at a block boundary
+                      const size_t input_size = size / input_fraction;
+                      univector<complex<float_type>> in =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      for (size_t i = input_size; i < size; i++)
+                          in[i] = 0;
+                      const dft_pruning ranges[] = { { input_size, 0, size },
+                                                     { input_size, size / 3, size / 3 + size / 7 + 1 },
+                                                     { input_size, 0, size / 8 } };
+
+                      const dft_plan<float_type> full(size);
+                      univector<u8> temp(full.temp_size);
+                      univector<complex<float_type>> ref(size);
+                      full.execute(ref, in, temp);
+                      const double magnitude = rms(cabs(ref));
+
+                      for (const dft_pruning& pruning : ranges)
+                      {
+                          const dft_plan<float_type> plan(size, pruning);
+                          univector<complex<float_type>> out(size);
+                          univector<u8> pruned_temp(plan.temp_size);
+                          plan.execute(out, in, pruned_temp);
+                          const size_t bins = pruning.output_end - pruning.output_begin;
+                          CHECK(rms(cabs(ref.slice(pruning.output_begin, bins) -
+                                         out.slice(pruning.output_begin, bins))) < epsilon * ops * magnitude);
+
+                          // In place
+                          out = in;
+                          plan.execute(out, out, pruned_temp);
+                          CHECK(rms(cabs(ref.slice(pruning.output_begin, bins) -
+                                         out.slice(pruning.output_begin, bins))) < epsilon * ops * magnitude);
+
+                          // Spectra are written for the requested bins only
+                          univector<float_type> power(size, float_type(-1));
+                          out = in;
+                          plan.execute(power, out, pruned_temp, dft_spectrum::power);
+                          const univector<float_type> ref_magnitude =
+                              cabs(ref.slice(pruning.output_begin, bins));
+                          const univector<float_type> ref_power = ref_magnitude * ref_magnitude;
+                          CHECK(rms(ref_power - power.slice(pruning.output_begin, bins)) <
+                                epsilon * ops * magnitude * magnitude);
+                          size_t outside = 0;
+                          for (size_t i = 0; i < size; i++)
+                              if ((i < pruning.output_begin || i >= pruning.output_end) && power[i] != -1)
+                                  outside++;
+                          CHECK(outside == 0);
+                      }
+                  });
+}
+
+TEST(fft_batch)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")    = ctypes<float, double>, //
+                  named("size")    = std::vector<size_t>{ 16, 60, 97, 256, 4096 }, //
+                  named("istride") = std::vector<size_t>{ 1, 3 },
+                  [&gen](auto type, size_t size, size_t istride) {
+                      using float_type     = type_of<decltype(type)>;
+                      const size_t count   = 5;
+                      const size_t idist   = size * istride + 1;
+                      const double ops     = std::log2(size) * 100;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      univector<complex<float_type>> in =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), idist * count * 2);
+                      univector<complex<float_type>> out(size * count);
+                      const dft_plan<float_type> dft(size);
+                      univector<u8> temp(dft.temp_size);
+
+                      dft.execute_batch(out.data(), in.data(), temp.data(), count, istride, idist);
+
+                      for (size_t b = 0; b < count; b++)
+                      {
+                          univector<complex<float_type>> single(size);
+                          for (size_t i = 0; i < size; i++)
+                              single[i] = in[b * idist + i * istride];
+                          dft.execute(single, single, temp);
+                          CHECK(rms(cabs(single - out.slice(b * size, size))) < epsilon * ops);
+                      }
+                  });
+}
+
+TEST(fft_md_accuracy)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+    const std::vector<std::vector<size_t>> shapes{ { 6, 8 }, { 64, 64 }, { 17, 40 }, { 4, 5, 6 }, { 3, 32, 20 } };
+
+    testo::matrix(named("type")    = ctypes<float, double>, //
+                  named("inverse") = std::make_tuple(false, true), //
+                  named("shape")   = make_range(size_t(0), shapes.size()),
+                  [&gen, &shapes](auto type, bool inverse, size_t shape_index) {
+                      using float_type                 = type_of<decltype(type)>;
+                      const std::vector<size_t>& shape = shapes[shape_index];
+                      const dft_plan_md<float_type> dft(shape, dft_type::both, 3);
+                      const size_t size = dft.size;
+
+                      univector<complex<float_type>> in =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      univector<complex<float_type>> out(size);
+                      univector<complex<float_type>> refout = in;
+                      univector<u8> temp(dft.temp_size);
+
+                      size_t inner = 1;
+                      for (size_t axis = shape.size(); axis-- > 0;)
+                      {
+                          const size_t n = shape[axis];
+                          univector<complex<float_type>> line(n);
+                          for (size_t o = 0; o < size / (n * inner); o++)
+                              for (size_t j = 0; j < inner; j++)
+                              {
+                                  complex<float_type>* base = refout.data() + o * n * inner + j;
+                                  for (size_t i = 0; i < n; i++)
+                                      line[i] = base[i * inner];
+                                  reference_dft(line.data(), line.data(), n, inverse);
+                                  for (size_t i = 0; i < n; i++)
+                                      base[i * inner] = line[i];
+                              }
+                          inner *= n;
+                      }
+                      dft.execute(out, in, temp, inverse);
+
+                      const double ops     = std::log2(size) * 100;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      CHECK(rms(cabs(refout - out)) < epsilon * ops);
+                  });
+}
+
+TEST(fft_shared_data)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+    const size_t size = 65536;
+
+    const dft_plan<float> first(size);
+    const size_t allocated = internal::get_memory_statistics().allocation_size;
+    // Other directions, prefetching and pruned variants of the same size reuse all blocks of first
+    const dft_plan<float> second(size, dft_type::inverse);
+    const dft_plan<float> unprefetched(size, dft_type::both, dft_plan_choice{ first.choice.cpu, false });
+    const dft_plan<float> pruned(size, dft_pruning{ size / 2, 0, size });
+    CHECK(internal::get_memory_statistics().allocation_size == allocated);
+    // Twiddles of a stage only depend on its size, so a plan of 4x the size shares every stage of first
+    // and allocates only its new outer stage
+    const dft_plan<float> larger(size * 4);
+    const size_t outer = align_up(sizeof(complex<float>) * size * 3, native_cache_alignment);
+    CHECK(larger.data_size == first.data_size + outer);
+    CHECK(internal::get_memory_statistics().allocation_size - allocated == outer);
+
+    univector<complex<float>> in = typed<float>(gen_random_range(gen, -1.0, +1.0), size * 2);
+    univector<complex<float>> out1(size);
+    univector<complex<float>> out2(size);
+    univector<u8> temp(first.temp_size);
+    first.execute(out1, in, temp, true);
+    second.execute(out2, in, temp, true);
+    CHECK(rms(cabs(out1 - out2)) == 0);
+}
+
+TEST(fft_wisdom)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+    const size_t size             = 12288;
+    const std::string path        = "dft_test.wisdom";
+    univector<complex<double>> in = typed<double>(gen_random_range(gen, -1.0, +1.0), size * 2);
+    univector<complex<double>> refout(size);
+    univector<complex<double>> out(size);
+    {
+        const dft_plan<double> dft(size);
+        univector<u8> temp(dft.temp_size);
+        dft.execute(refout, in, temp);
+        CHECK(save_dft_wisdom(path));
+    }
+
+    const std::shared_ptr<const dft_wisdom> wisdom = load_dft_wisdom(path);
+    CHECK(wisdom != nullptr);
+    CHECK(wisdom->size() > 0);
+    const size_t allocated = internal::get_memory_statistics().allocation_size;
+    const dft_plan<double> dft(size);
+    // All stage data comes from the file
+    CHECK(internal::get_memory_statistics().allocation_size == allocated);
+    univector<u8> temp(dft.temp_size);
+    dft.execute(out, in, temp);
+    CHECK(rms(cabs(refout - out)) == 0);
+
+    CHECK(load_dft_wisdom("missing.wisdom") == nullptr);
+    std::remove(path.c_str());
+}
+
+TEST(fft_measure)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("size") = std::vector<size_t>{ 60, 97, 256, 4096, 32768 }, [&gen](size_t size) {
+        const dft_plan<double> dft(size, dft_type::both, dft_planning::measure);
+        CHECK(dft.choice.cpu <= get_cpu());
+
+        // The choice is recorded and reused
+        const dft_plan<double> again(size, dft_type::both, dft_planning::measure);
+        CHECK(again.choice.cpu == dft.choice.cpu);
+        CHECK(again.choice.prefetch == dft.choice.prefetch);
+        CHECK(again.choice.final_size == dft.choice.final_size);
+
+        univector<complex<double>> in = typed<double>(gen_random_range(gen, -1.0, +1.0), size * 2);
+        univector<complex<double>> out(size);
+        univector<complex<double>> refout(size);
+        univector<u8> temp(dft.temp_size);
+        reference_dft(refout.data(), in.data(), size, false);
+        dft.execute(out, in, temp);
+        CHECK(rms(cabs(refout - out)) < std::numeric_limits<double>::epsilon() * std::log2(size) * 100);
+    });
+}
+
+TEST(fft_plan_cache)
+{
+    dft_plan_cache<float>& cache = dft_plan_cache<float>::instance();
+    cache.clear();
+
+    const std::shared_ptr<const dft_plan<float>> plan = get_dft_plan<float>(1024);
+    CHECK(get_dft_plan<float>(1024) == plan);
+    CHECK(get_dft_plan<float>(1024, dft_type::direct) != plan);
+    CHECK(cache.size() == 2);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++)
+        threads.emplace_back([]() {
+            for (size_t i = 0; i < 200; i++)
+                get_dft_plan<float>(16 + i % 20);
+        });
+    for (std::thread& t : threads)
+        t.join();
+    CHECK(cache.size() == 22);
+
+    // Evicted plans stay valid for their holders
+    cache.set_memory_limit(cache.memory_usage() / 2);
+    CHECK(cache.size() < 22);
+    CHECK(plan->size == 1024);
+    cache.set_memory_limit(dft_plan_cache<float>::default_memory_limit);
+
+    // Stage data shared with a plan outside the cache isn't held by the cache
+    cache.clear();
+    get_dft_plan<float>(4096);
+    const size_t usage = cache.memory_usage();
+    CHECK(usage > sizeof(dft_plan<float>));
+    {
+        const dft_plan<float> outside(4096);
+        CHECK(cache.memory_usage() == sizeof(dft_plan<float>));
+    }
+    CHECK(cache.memory_usage() == usage);
+    cache.clear();
+    CHECK(cache.memory_usage() == 0);
+}
+
+TEST(fft_convolver)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")        = ctypes<float, double>, //
+                  named("kernel size") = std::vector<size_t>{ 1, 5, 256, 1000 }, //
+                  named("block")       = std::vector<size_t>{ 0, 64, 4096 }, //
+                  [&gen](auto type, size_t kernel_size, size_t block) {
+                      using float_type  = type_of<decltype(type)>;
+                      const size_t size = 10000;
+
+                      univector<float_type> kernel =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), kernel_size);
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+
+                      const univector<float_type> ref = convolve(in, kernel);
+
+                      // Arbitrary call sizes, including ones that straddle segment boundaries
+                      fft_convolver<float_type> conv(kernel, block);
+                      const size_t latency = conv.latency();
+                      CHECK(latency >= block);
+                      univector<float_type> out(size);
+                      const size_t steps[] = { 1, 7, 300, 64, 2049, 13, 1000 };
+                      for (size_t i = 0, step = 0; i < size; step++)
+                      {
+                          const size_t count = std::min(steps[step % arraysize(steps)], size - i);
+                          conv.process(out.data() + i, in.data() + i, count);
+                          i += count;
+                      }
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      CHECK(rms(out.slice(0, latency)) == 0);
+                      const univector<float_type> delayed = typed<float_type>(ref, size - latency);
+                      CHECK(rms(delayed - out.slice(latency)) < epsilon * 1000);
+                  });
+}
+
+TEST(fft_partitioned_convolver)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")        = ctypes<float, double>, //
+                  named("kernel size") = std::vector<size_t>{ 1, 100, 5000 }, //
+                  named("block")       = std::vector<size_t>{ 16, 64, 512 }, //
+                  [&gen](auto type, size_t kernel_size, size_t block) {
+                      using float_type  = type_of<decltype(type)>;
+                      const size_t size = 10000;
+
+                      univector<float_type> kernel =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), kernel_size);
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+
+                      const univector<float_type> ref = convolve(in, kernel);
+
+                      fft_partitioned_convolver<float_type> conv(kernel, block);
+                      const size_t latency = conv.latency();
+                      univector<float_type> out(size);
+                      const size_t steps[] = { 1, 7, 300, 64, 2049, 13, 1000 };
+                      for (size_t i = 0, step = 0; i < size; step++)
+                      {
+                          const size_t count = std::min(steps[step % arraysize(steps)], size - i);
+                          conv.process(out.data() + i, in.data() + i, count);
+                          i += count;
+                      }
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      const univector<float_type> delayed = typed<float_type>(ref, size - latency);
+                      CHECK(rms(out.slice(0, latency)) == 0);
+                      CHECK(rms(delayed - out.slice(latency)) < epsilon * 1000);
+
+                      // Whole blocks have no latency
+                      conv.reset();
+                      const size_t blocks = size / conv.block_size * conv.block_size;
+                      for (size_t i = 0; i < blocks; i += conv.block_size)
+                          conv.process_block(out.data() + i, in.data() + i);
+                      CHECK(rms(typed<float_type>(ref, blocks) - out.slice(0, blocks)) < epsilon * 1000);
+                  });
+}
+
+TEST(fft_nonuniform_convolver)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")        = ctypes<float, double>, //
+                  named("kernel size") = std::vector<size_t>{ 100, 20000 }, //
+                  named("threads")     = std::vector<size_t>{ 0, 1, 2 }, //
+                  [&gen](auto type, size_t kernel_size, size_t threads) {
+                      using float_type  = type_of<decltype(type)>;
+                      const size_t size = 30000;
+
+                      univector<float_type> kernel =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), kernel_size);
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+
+                      const univector<float_type> ref = convolve(in, kernel);
+
+                      fft_nonuniform_convolver<float_type> conv(kernel, 32, 1024, threads);
+                      CHECK(conv.tail_stages() == (kernel_size > 224 ? size_t(3) : size_t(0)));
+                      const size_t latency = conv.latency();
+                      univector<float_type> out(size);
+                      const size_t steps[] = { 1, 7, 300, 64, 2049, 13, 1000 };
+                      for (size_t i = 0, step = 0; i < size; step++)
+                      {
+                          const size_t count = std::min(steps[step % arraysize(steps)], size - i);
+                          conv.process(out.data() + i, in.data() + i, count);
+                          i += count;
+                      }
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      const univector<float_type> delayed = typed<float_type>(ref, size - latency);
+                      CHECK(rms(out.slice(0, latency)) == 0);
+                      CHECK(rms(delayed - out.slice(latency)) < epsilon * 100 * rms(ref));
+                  });
+}
+
+TEST(stft)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")    = ctypes<float, double>, //
+                  named("hop")     = std::vector<size_t>{ 128, 200, 512 }, //
+                  named("threads") = std::vector<size_t>{ 1, 3 }, //
+                  [&gen](auto type, size_t hop, size_t threads) {
+                      using float_type        = type_of<decltype(type)>;
+                      const size_t frame_size = 512;
+                      const size_t size       = 10000;
+
+                      univector<float_type> window(frame_size);
+                      for (size_t i = 0; i < frame_size; i++)
+                          window[i] = float_type(0.54 - 0.46 * std::cos(c_pi<double, 2> * i / frame_size));
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+
+                      const stft_plan<float_type> stft(window, hop, threads);
+                      const size_t frames = stft.frames(size);
+                      univector<u8> temp(stft.temp_size);
+                      univector<complex<float_type>> spectrogram(frames * stft.bins);
+                      stft.execute(spectrogram, in, temp);
+
+                      // Last frame against a plain real FFT of the windowed slice
+                      const dft_plan_real<float_type> dft(frame_size);
+                      univector<u8> dft_temp(dft.temp_size);
+                      univector<float_type> slice = in.slice((frames - 1) * hop, frame_size) * window;
+                      univector<complex<float_type>> ref(stft.bins);
+                      dft.execute(ref, slice, dft_temp);
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      CHECK(rms(cabs(ref - spectrogram.slice((frames - 1) * stft.bins))) < epsilon * 1000);
+
+                      univector<float_type> out(stft.signal_size(frames));
+                      stft.execute(out, spectrogram, temp);
+                      CHECK(rms(out - in.slice(0, out.size())) < epsilon * 100);
+                  });
+
+    // Invalid windows and hop sizes give an empty plan without frames
+    const univector<float> window(512, 1.f);
+    const univector<float> odd(511, 1.f);
+    CHECK(stft_plan<float>(window, 0).frames(10000) == 0);
+    CHECK(stft_plan<float>(window, 513).frame_size == 0);
+    CHECK(stft_plan<float>(window, 513).frames(10000) == 0);
+    CHECK(stft_plan<float>(odd, 128).frames(10000) == 0);
+    CHECK(stft_plan<float>(univector<float>(), 128).frames(10000) == 0);
+    CHECK(stft_plan<float>(window, 512).frames(10000) == 19);
+}
+
+TEST(window_functions)
+{
+    // Reference I0 by the same series, evaluated in double until it stops changing
+    const auto bessel_i0 = [](double x) {
+        double term = 1;
+        double sum  = 1;
+        for (size_t k = 1; term > sum * 1e-18; k++)
+        {
+            term *= x * x * 0.25 / double(k * k);
+            sum += term;
+        }
+        return sum;
+    };
+    const auto cosine_sum = [](std::initializer_list<double> a, double x) {
+        double result = 0;
+        size_t k      = 0;
+        for (double ak : a)
+        {
+            result += (k % 2 ? -ak : ak) * std::cos(c_pi<double, 2> * k * x);
+            k++;
+        }
+        return result;
+    };
+
+    testo::matrix(named("type")     = ctypes<float, double>, //
+                  named("size")     = std::vector<size_t>{ 1, 16, 511 }, //
+                  named("periodic") = std::make_tuple(false, true), //
+                  [&](auto type, size_t size, bool periodic) {
+                      using float_type = type_of<decltype(type)>;
+                      const window_symmetry symmetry =
+                          periodic ? window_symmetry::periodic : window_symmetry::symmetric;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      const univector<float_type> hann     = window_hann<float_type>(size, symmetry);
+                      const univector<float_type> hamming  = window_hamming<float_type>(size, symmetry);
+                      const univector<float_type> blackman = window_blackman<float_type>(size, symmetry);
+                      const univector<float_type> flattop  = window_flattop<float_type>(size, symmetry);
+                      const univector<float_type> kaiser   = window_kaiser<float_type>(size, 8, symmetry);
+                      CHECK(hann.size() == size);
+
+                      double error = 0;
+                      for (size_t i = 0; i < size; i++)
+                      {
+                          const double x = size == 1 ? 0.5 : double(i) / (periodic ? size : size - 1);
+                          const double t = 2 * x - 1;
+                          const double flattop_ref = cosine_sum(
+                              { 0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368 }, x);
+                          const double kaiser_ref =
+                              bessel_i0(8 * std::sqrt(std::max(1 - t * t, 0.0))) / bessel_i0(8);
+                          error = std::max(error, std::abs(hann[i] - cosine_sum({ 0.5, 0.5 }, x)));
+                          error = std::max(error, std::abs(hamming[i] - cosine_sum({ 0.54, 0.46 }, x)));
+                          error = std::max(error, std::abs(blackman[i] - cosine_sum({ 0.42, 0.5, 0.08 }, x)));
+                          error = std::max(error, std::abs(flattop[i] - flattop_ref));
+                          error = std::max(error, std::abs(kaiser[i] - kaiser_ref));
+                      }
+                      CHECK(error < epsilon * 50);
+                  });
+
+    // Windows are expressions and fuse with other expressions without a table
+    univector<float> input(100, 2.f);
+    const univector<float> windowed = input * window_hann<float>(input.size());
+    CHECK(windowed.size() == input.size());
+    CHECK(std::abs(windowed[50] - 2 * (0.5 - 0.5 * std::cos(c_pi<double, 2> * 50 / 99))) < 1e-6);
+}
+
+TEST(dct_accuracy)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    // DCT-II, DCT-III and DCT-IV
+    const dct_type types[] = { dct_type::II, dct_type::III, dct_type::IV };
+    testo::matrix(named("type") = ctypes<float, double>, //
+                  named("dct")  = std::vector<size_t>{ 0, 1, 2 }, //
+                  named("size") = std::vector<size_t>{ 2, 16, 60, 256 }, //
+                  [&](auto type, size_t dct_index, size_t size) {
+                      using float_type   = type_of<decltype(type)>;
+                      const dct_type dct = types[dct_index];
+
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+                      univector<float_type> out(size);
+                      univector<double> ref(size);
+                      for (size_t k = 0; k < size; k++)
+                      {
+                          double sum = 0;
+                          for (size_t n = 0; n < size; n++)
+                          {
+                              switch (dct)
+                              {
+                              case dct_type::II:
+                                  sum += 2 * in[n] * std::cos(c_pi<double> * (2 * n + 1) * k / (2 * size));
+                                  break;
+                              case dct_type::III:
+                                  sum += (n ? 2 : 1) * in[n] *
+                                         std::cos(c_pi<double> * (2 * k + 1) * n / (2 * size));
+                                  break;
+                              case dct_type::IV:
+                                  sum += 2 * in[n] *
+                                         std::cos(c_pi<double> * (2 * n + 1) * (2 * k + 1) / (4 * size));
+                                  break;
+                              }
+                          }
+                          ref[k] = sum;
+                      }
+
+                      const dct_plan<float_type> plan(size, dct);
+                      univector<u8> temp(plan.temp_size);
+                      plan.execute(out, in, temp);
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      CHECK(rms(ref - out) < epsilon * size * 10);
+                  });
+
+    // Odd sizes and 0 give empty plans
+    for (size_t dct_index = 0; dct_index < 3; dct_index++)
+    {
+        CHECK(dct_plan<float>(0, types[dct_index]).size == 0);
+        CHECK(dct_plan<float>(1, types[dct_index]).size == 0);
+        CHECK(dct_plan<float>(15, types[dct_index]).size == 0);
+    }
+    CHECK(dst_plan<float>(1).size == 0);
+    CHECK(mdct_plan<float>(0).size == 0);
+    CHECK(mdct_plan<float>(15).size == 0);
+}
+
+TEST(dst_accuracy)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    // DST-II and DST-III
+    const dst_type types[] = { dst_type::II, dst_type::III };
+    testo::matrix(named("type") = ctypes<float, double>, //
+                  named("dst")  = std::vector<size_t>{ 0, 1 }, //
+                  named("size") = std::vector<size_t>{ 2, 16, 60, 256 }, //
+                  [&](auto type, size_t dst_index, size_t size) {
+                      using float_type   = type_of<decltype(type)>;
+                      const dst_type dst = types[dst_index];
+
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+                      univector<double> ref(size);
+                      for (size_t k = 0; k < size; k++)
+                      {
+                          double sum = 0;
+                          for (size_t n = 0; n < size; n++)
+                          {
+                              if (dst == dst_type::II)
+                                  sum += 2 * in[n] *
+                                         std::sin(c_pi<double> * (2 * n + 1) * (k + 1) / (2 * size));
+                              else
+                                  sum += (n + 1 < size ? 2 : 1) * in[n] *
+                                         std::sin(c_pi<double> * (2 * k + 1) * (n + 1) / (2 * size));
+                          }
+                          ref[k] = sum;
+                      }
+
+                      const dst_plan<float_type> plan(size, dst);
+                      univector<u8> temp(plan.temp_size);
+                      univector<float_type> out = in;
+                      plan.execute(out, out, temp);
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      CHECK(rms(ref - out) < epsilon * size * 10);
+                  });
+}
+
+TEST(mdct)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type") = ctypes<float, double>, //
+                  named("size") = std::vector<size_t>{ 2, 16, 60, 256 }, //
+                  [&gen](auto type, size_t size) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      univector<float_type> in =
+                          typed<float_type>(gen_random_range(gen, -1.0, +1.0), size * 2);
+                      univector<float_type> coefficients(size);
+                      univector<float_type> aliased(size * 2);
+                      const mdct_plan<float_type> plan(size);
+                      univector<u8> temp(plan.temp_size);
+                      plan.execute(coefficients, in, temp);
+                      plan.execute(aliased, coefficients, temp, true);
+
+                      const auto basis = [size](size_t n, size_t k) {
+                          return std::cos(c_pi<double> / size * (n + 0.5 + size * 0.5) * (k + 0.5));
+                      };
+                      univector<double> ref(size);
+                      for (size_t k = 0; k < size; k++)
+                      {
+                          double sum = 0;
+                          for (size_t n = 0; n < size * 2; n++)
+                              sum += in[n] * basis(n, k);
+                          ref[k] = sum;
+                      }
+                      CHECK(rms(ref - coefficients) < epsilon * size * 10);
+
+                      univector<double> ref_aliased(size * 2);
+                      for (size_t n = 0; n < size * 2; n++)
+                      {
+                          double sum = 0;
+                          for (size_t k = 0; k < size; k++)
+                              sum += coefficients[k] * basis(n, k);
+                          ref_aliased[n] = sum;
+                      }
+                      CHECK(rms(ref_aliased - aliased) < epsilon * size * 10);
+                  });
+}
+
+TEST(welch_psd)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    const psd_detrend detrends[] = { psd_detrend::none, psd_detrend::mean, psd_detrend::linear };
+    testo::matrix(named("type")    = ctypes<float, double>, //
+                  named("detrend") = std::vector<size_t>{ 0, 1, 2 }, //
+                  named("hop")     = std::vector<size_t>{ 16, 64 }, //
+                  named("threads") = std::vector<size_t>{ 1, 3 }, //
+                  [&](auto type, size_t detrend_index, size_t hop, size_t threads) {
+                      using float_type        = type_of<decltype(type)>;
+                      const psd_detrend trend = detrends[detrend_index];
+                      const size_t size       = 1000;
+                      const size_t segment    = 64;
+
+                      // A ramp on top of noise so that detrending matters
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+                      for (size_t i = 0; i < size; i++)
+                          in[i] += float_type(0.01) * i;
+
+                      const univector<float_type> window = window_hann<float_type>(segment);
+                      const welch_plan<float_type> plan(window, hop, trend, threads);
+                      univector<float_type> out(plan.bins);
+                      univector<u8> temp(plan.temp_size);
+                      plan.execute(out, in, temp);
+
+                      univector<double> ref(plan.bins, 0.0);
+                      double window_power = 0;
+                      for (size_t n = 0; n < segment; n++)
+                          window_power += window[n] * window[n];
+                      const size_t count = plan.segments(size);
+                      for (size_t s = 0; s < count; s++)
+                      {
+                          const float_type* x = in.data() + s * hop;
+                          double mean = 0, slope = 0;
+                          if (trend != psd_detrend::none)
+                          {
+                              double sx = 0, sxx = 0, sy = 0, sxy = 0;
+                              for (size_t n = 0; n < segment; n++)
+                              {
+                                  sx += n;
+                                  sxx += double(n) * n;
+                                  sy += x[n];
+                                  sxy += n * double(x[n]);
+                              }
+                              if (trend == psd_detrend::linear)
+                                  slope = (segment * sxy - sx * sy) / (segment * sxx - sx * sx);
+                              mean = (sy - slope * sx) / segment;
+                          }
+                          for (size_t k = 0; k < plan.bins; k++)
+                          {
+                              double re = 0, im = 0;
+                              for (size_t n = 0; n < segment; n++)
+                              {
+                                  const double v = (x[n] - mean - slope * n) * window[n];
+                                  re += v * std::cos(c_pi<double, 2> * k * n / segment);
+                                  im -= v * std::sin(c_pi<double, 2> * k * n / segment);
+                              }
+                              const double factor = (k == 0 || k * 2 == segment) ? 1 : 2;
+                              ref[k] += factor * (re * re + im * im) / window_power / count;
+                          }
+                      }
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+                      CHECK(rms(ref - out) < epsilon * 100 * rms(ref));
+                  });
+
+    // Invalid windows and hop sizes give an empty plan without segments
+    const univector<float> window(256, 1.f);
+    const univector<float> odd(255, 1.f);
+    CHECK(welch_plan<float>(window, 0).segments(10000) == 0);
+    CHECK(welch_plan<float>(window, 0).segment_size == 0);
+    CHECK(welch_plan<float>(odd, 128).segments(10000) == 0);
+    CHECK(welch_plan<float>(univector<float>(), 128).segments(10000) == 0);
+    CHECK(welch_plan<float>(window, 128).segments(10000) == 77);
+}
+
+TEST(goertzel)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type") = ctypes<float, double>, //
+                  named("size") = std::vector<size_t>{ 1, 100, 1000 }, //
+                  [&gen](auto type, size_t size) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+                      const std::vector<double> list{ 0.0, 0.1, 0.25, 0.3331, 0.5, 0.017, 0.9, 0.42, 0.125 };
+                      const univector<float_type> frequencies(list.begin(), list.end());
+                      goertzel_bank<float_type> bank(frequencies);
+                      // Expression input, then the rest pushed from memory
+                      process<float_type>(bank, in.slice(0, size / 2), size / 2);
+                      bank.push(in.data() + size / 2, size - size / 2);
+                      CHECK(bank.count == size);
+
+                      univector<complex<float_type>> out(bank.bins);
+                      univector<float_type> power(bank.bins);
+                      bank.result(out.data());
+                      bank.power(power.data());
+                      univector<complex<float_type>> ref(bank.bins);
+                      for (size_t b = 0; b < bank.bins; b++)
+                      {
+                          double re = 0, im = 0;
+                          for (size_t n = 0; n < size; n++)
+                          {
+                              re += in[n] * std::cos(c_pi<double, 2> * frequencies[b] * n);
+                              im -= in[n] * std::sin(c_pi<double, 2> * frequencies[b] * n);
+                          }
+                          ref[b] = make_complex(static_cast<float_type>(re), static_cast<float_type>(im));
+                      }
+                      const double magnitude = rms(cabs(ref));
+                      CHECK(rms(cabs(ref - out)) < epsilon * size * 10 * magnitude);
+                      CHECK(rms(cabs(ref) * cabs(ref) - power) < epsilon * size * 10 * magnitude * magnitude);
+                  });
+}
+
+TEST(sliding_dft)
+{
+    random_bit_generator gen(2247448713, 915890490, 864203735, 2982561);
+
+    testo::matrix(named("type")   = ctypes<float, double>, //
+                  named("window") = std::vector<size_t>{ 1, 7, 64 }, //
+                  named("size")   = std::vector<size_t>{ 3, 50, 10000 }, //
+                  [&gen](auto type, size_t window, size_t size) {
+                      using float_type     = type_of<decltype(type)>;
+                      const double epsilon = std::numeric_limits<float_type>::epsilon();
+
+                      univector<float_type> in = typed<float_type>(gen_random_range(gen, -1.0, +1.0), size);
+                      std::vector<size_t> bins;
+                      for (size_t k : { size_t(0), size_t(1), window / 2, window - 1, size_t(5) })
+                          if (k < window)
+                              bins.push_back(k);
+                      sliding_dft<float_type> sdft(window, bins);
+                      process<float_type>(sdft, in.slice(0, size / 3), size / 3);
+                      sdft.push(in.data() + size / 3, size - size / 3);
+
+                      univector<complex<float_type>> out(bins.size());
+                      univector<float_type> power(bins.size());
+                      sdft.result(out.data());
+                      sdft.power(power.data());
+                      univector<complex<float_type>> ref(bins.size());
+                      for (size_t b = 0; b < bins.size(); b++)
+                      {
+                          // DFT of the last window samples, zeros before the first sample
+                          double re = 0, im = 0;
+                          for (size_t m = 0; m < window; m++)
+                          {
+                              const double x = size + m >= window ? double(in[size + m - window]) : 0.0;
+                              re += x * std::cos(c_pi<double, 2> * bins[b] * m / window);
+                              im -= x * std::sin(c_pi<double, 2> * bins[b] * m / window);
+                          }
+                          ref[b] = make_complex(static_cast<float_type>(re), static_cast<float_type>(im));
+                      }
+                      // Rounding errors of the running sums grow with the square root of the sample count
+                      const double tolerance = epsilon * (window + std::sqrt(size)) * 10;
+                      CHECK(rms(cabs(ref - out)) < tolerance * std::sqrt(window));
+                      CHECK(rms(cabs(ref) * cabs(ref) - power) < tolerance * window);
+                  });
+}
+
 int main(int argc, char** argv)
 {
     println(library_version());
+    println("cpu: ", cpu_name(get_cpu()));
 
     return testo::run_all("", true);
 }
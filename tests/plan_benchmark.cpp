@@ -0,0 +1,46 @@
+/**
+ * KFR (http://kfrlib.com)
+ * Copyright (C) 2016  D Levin
+ * See LICENSE.txt for details
+ */
+
+// Reports dft_plan construction latency for power-of-two sizes
+
+#include <algorithm>
+#include <chrono>
+
+#include <kfr/cometa/string.hpp>
+#include <kfr/dft/fft.hpp>
+#include <kfr/version.hpp>
+
+using namespace kfr;
+
+template <typename T>
+static double plan_creation_ms(size_t size)
+{
+    const size_t runs = size >= (1 << 20) ? 3 : 15;
+    double best       = 0;
+    for (size_t r = 0; r < runs; r++)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        const dft_plan<T> dft(size);
+        const auto stop = std::chrono::high_resolution_clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+        best            = r == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    println(library_version());
+    println("cpu: ", cpu_name(get_cpu()));
+    println("log2(size)  float, ms  double, ms");
+    for (size_t log2size = 4; log2size <= 24; log2size++)
+    {
+        const size_t size = size_t(1) << log2size;
+        println(padright(10, as_string(log2size)), padright(11, as_string(plan_creation_ms<float>(size))),
+                padright(12, as_string(plan_creation_ms<double>(size))));
+    }
+    return 0;
+}
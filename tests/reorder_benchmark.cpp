@@ -0,0 +1,69 @@
+/**
+ * KFR (http://kfrlib.com)
+ * Copyright (C) 2016  D Levin
+ * See LICENSE.txt for details
+ */
+
+// Compares the swap-based and the cache-blocked FFT reorder for power-of-two sizes
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include <kfr/cometa/string.hpp>
+#include <kfr/dft/fft.hpp>
+#include <kfr/version.hpp>
+
+using namespace kfr;
+
+template <typename T, typename Fn>
+static double reorder_ns_per_point(size_t log2size, Fn&& fn)
+{
+    const size_t size = size_t(1) << log2size;
+    univector<complex<T>> data(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = complex<T>(T(i), T(0));
+    const size_t runs = std::max(size_t(3), (size_t(1) << 24) >> log2size);
+    double best       = 0;
+    for (size_t r = 0; r < runs; r++)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        fn(data.data(), log2size);
+        const auto stop = std::chrono::high_resolution_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / size;
+        best            = r == 0 ? ns : std::min(best, ns);
+    }
+    return best;
+}
+
+template <typename T>
+static std::string compare_reorders(size_t log2size)
+{
+    const double swaps = reorder_ns_per_point<T>(log2size, [](complex<T>* data, size_t log2n) {
+        if (log2n % 2)
+            internal::fft_reorder_swaps(data, log2n, ctrue);
+        else
+            internal::fft_reorder_swaps(data, log2n, cfalse);
+    });
+    const double blocked = reorder_ns_per_point<T>(log2size, [](complex<T>* data, size_t log2n) {
+        if (log2n % 2)
+            internal::fft_reorder_blocked(data, log2n, ctrue);
+        else
+            internal::fft_reorder_blocked(data, log2n, cfalse);
+    });
+    return as_string(padright(12, as_string(swaps)), padright(14, as_string(blocked)));
+}
+
+int main(int argc, char** argv)
+{
+    println(library_version());
+    println("cpu: ", cpu_name(get_cpu()));
+    println("ns per point");
+    println("log2(size)  float swaps float blocked double swaps double blocked");
+    for (size_t log2size = 10; log2size <= 24; log2size++)
+    {
+        println(padright(12, as_string(log2size)), compare_reorders<float>(log2size),
+                compare_reorders<double>(log2size));
+    }
+    return 0;
+}